@@ -0,0 +1,1123 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "alarm_sequence.h"
+#include "alarm_rule.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
+    g_warning(fmt, ## args); }
+
+/**
+ * Deepest nesting accepted, keeps the parser stack bounded
+ */
+#define MAX_NESTING         32
+
+/**
+ * Most mask terms per rule, larger rules are evaluated as a program
+ */
+#define MAX_TERMS           32
+
+/**
+ * Bit of a scenario in the state mask
+ */
+#define BIT(index)          (G_GUINT64_CONSTANT(1) << (index))
+
+/**
+ * Most operand combinations a k-of-n group is expanded to, larger groups
+ * are evaluated as a program
+ */
+#define MAX_COMBINATIONS    256
+
+/**
+ * Bit of a sequence in the state mask, allocated from the top
+ */
+#define SEQUENCE_BIT(index) (ALARM_RULE_MAX - 1 - (guint) (index))
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Instructions of the flat evaluation program
+ */
+typedef enum {
+    OP_PUSH,
+    OP_NOT,
+    OP_AND,
+    OP_OR,
+    OP_AT_LEAST
+} AlarmRuleOp;
+
+/**
+ * One instruction. OP_PUSH uses index, OP_AT_LEAST pops count operands
+ * and pushes whether at least k of them are true.
+ */
+typedef struct {
+    AlarmRuleOp op;
+    guint index;
+    guint k;
+    guint count;
+} AlarmRuleInsn;
+
+/**
+ * Conjunction of scenario states, true when all required scenarios are
+ * active and no forbidden one is
+ */
+typedef struct {
+    guint64 required;
+    guint64 forbidden;
+} AlarmRuleTerm;
+
+/**
+ * One rule, true when any of its terms is. Rules that would need too many
+ * terms keep their program instead.
+ */
+typedef struct {
+    gchar *expression;
+    gboolean masks;
+    guint first_term;
+    guint n_terms;
+    GArray *program;
+} AlarmRuleEntry;
+
+/**
+ * Compiled combined alarm rules with the state of their scenarios
+ */
+struct AlarmRule {
+    GPtrArray *scenarios;
+    GPtrArray *sequence_names;
+    AlarmSequences *sequences;
+    guint64 sequence_states;
+    guint64 active;
+    GArray *rules;
+    GArray *terms;
+    gboolean *stack;
+};
+
+/**
+ * Parser state while compiling an expression
+ */
+typedef struct {
+    const char *p;
+    AlarmRule *rule;
+    GArray *program;
+    guint depth;
+    guint max_depth;
+    guint nesting;
+    gboolean failed;
+} AlarmRuleParser;
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Skip whitespace
+ */
+static void skip_space(AlarmRuleParser *parser);
+
+/**
+ * Length of the scenario name or number starting at the cursor
+ */
+static gsize name_length(const char *p);
+
+/**
+ * Scenario name at p, bare or in double quotes. Sets name and length to
+ * the name without quotes, returns the characters used, 0 if none.
+ */
+static gsize read_name(const char *p, const char **name, gsize *length);
+
+/**
+ * TRUE if the keyword starts at p as a word of its own
+ */
+static gboolean is_keyword(const char *p, const char *keyword);
+
+/**
+ * Split on ';' outside quoted names, dropping empty entries
+ */
+static GPtrArray *split_entries(const char *source);
+
+/**
+ * Append an instruction and track the evaluation stack depth
+ */
+static void emit(AlarmRuleParser *parser, AlarmRuleOp op, guint index,
+    guint k, guint count);
+
+/**
+ * Index of a scenario, added to the rule if it is new
+ */
+static guint scenario_index(AlarmRule *rule, const char *name, gsize length);
+
+/**
+ * Index of a sequence by name, -1 if there is none
+ */
+static int sequence_index(const AlarmRule *rule, const char *name,
+    gsize length);
+
+/**
+ * Parse "<name> = <scenario> then <scenario> ... within <ms>"
+ */
+static gboolean parse_sequence(AlarmRule *rule, const char *source);
+
+/**
+ * Parse "<term> ('|' <term>)*"
+ */
+static void parse_or(AlarmRuleParser *parser);
+
+/**
+ * Parse "<factor> ('&' <factor>)*"
+ */
+static void parse_and(AlarmRuleParser *parser);
+
+/**
+ * Parse a negation, parenthesis, k-of-n group or scenario name
+ */
+static void parse_factor(AlarmRuleParser *parser);
+
+/**
+ * Add a term unless it is contradictory or already present, FALSE if the
+ * list would grow too large
+ */
+static gboolean terms_add(GArray *terms, guint64 required, guint64 forbidden);
+
+/**
+ * Terms of a AND b, NULL if too many
+ */
+static GArray *terms_and(const GArray *a, const GArray *b);
+
+/**
+ * Terms of a OR b, NULL if too many
+ */
+static GArray *terms_or(const GArray *a, const GArray *b);
+
+/**
+ * Terms of NOT a, NULL if too many
+ */
+static GArray *terms_not(const GArray *a);
+
+/**
+ * Terms true when at least k of the count operands are, NULL if too many
+ */
+static GArray *terms_at_least(GArray **operands, guint count, guint k);
+
+/**
+ * Rewrite a program as OR of AND terms, NULL if it needs too many
+ */
+static GArray *terms_from_program(const GArray *program);
+
+/**
+ * Run the program of a rule that could not be reduced to terms
+ */
+static gboolean run_program(const AlarmRule *rule, const GArray *program);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Skip whitespace
+ */
+static void skip_space(AlarmRuleParser *parser)
+{
+    while (g_ascii_isspace(*parser->p)) {
+        parser->p++;
+    }
+}
+
+/**
+ * Length of the scenario name or number starting at the cursor
+ */
+static gsize name_length(const char *p)
+{
+    const char *start = p;
+
+    while (g_ascii_isalnum(*p) || *p == '-' || *p == '_' || *p == '.') {
+        p++;
+    }
+
+    return p - start;
+}
+
+/**
+ * Scenario name at p, bare or in double quotes. Sets name and length to
+ * the name without quotes, returns the characters used, 0 if none.
+ */
+static gsize read_name(const char *p, const char **name, gsize *length)
+{
+    const char *end;
+
+    if (*p != '"') {
+        *name = p;
+        *length = name_length(p);
+        return *length;
+    }
+
+    /* Quoted names may hold anything but the quote itself */
+    end = strchr(p + 1, '"');
+
+    if (!end || end == p + 1) {
+        *length = 0;
+        return 0;
+    }
+
+    *name = p + 1;
+    *length = end - p - 1;
+
+    return *length + 2;
+}
+
+/**
+ * TRUE if the keyword starts at p as a word of its own
+ */
+static gboolean is_keyword(const char *p, const char *keyword)
+{
+    gsize length = strlen(keyword);
+
+    return strncmp(p, keyword, length) == 0 && name_length(p) == length;
+}
+
+/**
+ * Split on ';' outside quoted names, dropping empty entries
+ */
+static GPtrArray *split_entries(const char *source)
+{
+    GPtrArray *entries = g_ptr_array_new_with_free_func(g_free);
+    const char *start = source ? source : "";
+    const char *p = start;
+    gboolean quoted = FALSE;
+
+    for (;; p++) {
+        if (*p == '"') {
+            quoted = !quoted;
+        } else if ((*p == ';' && !quoted) || *p == '\0') {
+            gchar *entry = g_strstrip(g_strndup(start, p - start));
+
+            if (*entry) {
+                g_ptr_array_add(entries, entry);
+            } else {
+                g_free(entry);
+            }
+
+            if (*p == '\0') {
+                break;
+            }
+
+            start = p + 1;
+        }
+    }
+
+    return entries;
+}
+
+/**
+ * Append an instruction and track the evaluation stack depth
+ */
+static void emit(AlarmRuleParser *parser, AlarmRuleOp op, guint index,
+    guint k, guint count)
+{
+    AlarmRuleInsn insn = { op, index, k, count };
+
+    g_array_append_val(parser->program, insn);
+
+    if (op == OP_PUSH) {
+        parser->depth++;
+        parser->max_depth = MAX(parser->max_depth, parser->depth);
+    } else if (op == OP_AND || op == OP_OR) {
+        parser->depth--;
+    } else if (op == OP_AT_LEAST) {
+        parser->depth -= count - 1;
+    }
+}
+
+/**
+ * Index of a scenario, added to the rule if it is new
+ */
+static guint scenario_index(AlarmRule *rule, const char *name, gsize length)
+{
+    guint i;
+
+    for (i = 0; i < rule->scenarios->len; i++) {
+        const char *known = g_ptr_array_index(rule->scenarios, i);
+
+        if (strlen(known) == length && strncmp(known, name, length) == 0) {
+            return i;
+        }
+    }
+
+    g_ptr_array_add(rule->scenarios, g_strndup(name, length));
+
+    return rule->scenarios->len - 1;
+}
+
+/**
+ * Index of a sequence by name, -1 if there is none
+ */
+static int sequence_index(const AlarmRule *rule, const char *name,
+    gsize length)
+{
+    guint i;
+
+    for (i = 0; i < rule->sequence_names->len; i++) {
+        const char *known = g_ptr_array_index(rule->sequence_names, i);
+
+        if (strlen(known) == length && strncmp(known, name, length) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Parse "<name> = <scenario> then <scenario> ... within <ms>"
+ */
+static gboolean parse_sequence(AlarmRule *rule, const char *source)
+{
+    GArray *steps = g_array_new(FALSE, FALSE, sizeof(guint));
+    const char *p = source;
+    const char *name = NULL;
+    const char *sequence;
+    gsize sequence_length;
+    gsize length;
+    gsize used;
+    gchar *end = NULL;
+    gint64 window = 0;
+    gboolean ok;
+    guint index;
+
+    while (g_ascii_isspace(*p)) {
+        p++;
+    }
+
+    used = read_name(p, &sequence, &sequence_length);
+    ok = used > 0 && sequence_index(rule, sequence, sequence_length) < 0;
+    p += used;
+
+    while (g_ascii_isspace(*p)) {
+        p++;
+    }
+
+    ok = ok && *p++ == '=';
+
+    /* Scenarios separated by "then", the last one followed by "within" */
+    while (ok) {
+        while (g_ascii_isspace(*p)) {
+            p++;
+        }
+
+        used = read_name(p, &name, &length);
+
+        if (!(ok = used > 0)) {
+            break;
+        }
+
+        index = scenario_index(rule, name, length);
+        g_array_append_val(steps, index);
+        p += used;
+
+        while (g_ascii_isspace(*p)) {
+            p++;
+        }
+
+        if (is_keyword(p, "within")) {
+            p += strlen("within");
+            break;
+        }
+
+        if (!(ok = is_keyword(p, "then"))) {
+            break;
+        }
+
+        p += strlen("then");
+    }
+
+    if (ok) {
+        window = g_ascii_strtoll(p, &end, 10);
+
+        while (g_ascii_isspace(*end)) {
+            end++;
+        }
+
+        ok = end != p && *end == '\0' && window > 0 && steps->len >= 2;
+    }
+
+    if (ok) {
+        alarm_sequences_add(rule->sequences, (const guint *) steps->data,
+            steps->len, window * 1000);
+        g_ptr_array_add(rule->sequence_names,
+            g_strndup(sequence, sequence_length));
+    } else {
+        ERR("Invalid alarm sequence '%s', expected "
+            "<name> = <scenario> then <scenario> ... within <ms>", source);
+    }
+
+    g_array_free(steps, TRUE);
+
+    return ok;
+}
+
+/**
+ * Parse "<term> ('|' <term>)*"
+ */
+static void parse_or(AlarmRuleParser *parser)
+{
+    parse_and(parser);
+
+    for (skip_space(parser); !parser->failed && *parser->p == '|';
+        skip_space(parser)) {
+        parser->p++;
+        parse_and(parser);
+        emit(parser, OP_OR, 0, 0, 0);
+    }
+}
+
+/**
+ * Parse "<factor> ('&' <factor>)*"
+ */
+static void parse_and(AlarmRuleParser *parser)
+{
+    parse_factor(parser);
+
+    for (skip_space(parser); !parser->failed && *parser->p == '&';
+        skip_space(parser)) {
+        parser->p++;
+        parse_factor(parser);
+        emit(parser, OP_AND, 0, 0, 0);
+    }
+}
+
+/**
+ * Parse a negation, parenthesis, k-of-n group or scenario name
+ */
+static void parse_factor(AlarmRuleParser *parser)
+{
+    const char *name;
+    gsize length;
+    gsize used;
+    const char *next;
+
+    skip_space(parser);
+
+    if (parser->failed || ++parser->nesting > MAX_NESTING) {
+        parser->failed = TRUE;
+        return;
+    }
+
+    length = name_length(parser->p);
+    next = parser->p + length;
+
+    while (g_ascii_isspace(*next)) {
+        next++;
+    }
+
+    if (*parser->p == '!') {
+        parser->p++;
+        parse_factor(parser);
+        emit(parser, OP_NOT, 0, 0, 0);
+    } else if (*parser->p == '(') {
+        parser->p++;
+        parse_or(parser);
+        skip_space(parser);
+
+        if (*parser->p != ')') {
+            parser->failed = TRUE;
+        } else {
+            parser->p++;
+        }
+    } else if (length > 0 && strspn(parser->p, "0123456789") == length &&
+        strncmp(next, "of", 2) == 0 && name_length(next) == 2) {
+        /* "<k> of (a, b, ...)" */
+        guint k = atoi(parser->p);
+        guint count = 0;
+
+        parser->p = next + 2;
+        skip_space(parser);
+
+        if (*parser->p != '(') {
+            parser->failed = TRUE;
+        } else {
+            do {
+                parser->p++;
+                parse_or(parser);
+                count++;
+                skip_space(parser);
+            } while (!parser->failed && *parser->p == ',');
+
+            if (*parser->p != ')' || k == 0 || k > count) {
+                parser->failed = TRUE;
+            } else {
+                parser->p++;
+                emit(parser, OP_AT_LEAST, 0, k, count);
+            }
+        }
+    } else if ((used = read_name(parser->p, &name, &length)) > 0) {
+        int sequence = sequence_index(parser->rule, name, length);
+
+        emit(parser, OP_PUSH, sequence >= 0 ? SEQUENCE_BIT(sequence) :
+            scenario_index(parser->rule, name, length), 0, 0);
+        parser->p += used;
+    } else {
+        parser->failed = TRUE;
+    }
+
+    parser->nesting--;
+}
+
+/**
+ * Add a term unless it is contradictory or already present, FALSE if the
+ * list would grow too large
+ */
+static gboolean terms_add(GArray *terms, guint64 required, guint64 forbidden)
+{
+    AlarmRuleTerm term = { required, forbidden };
+    guint i;
+
+    if (required & forbidden) {
+        return TRUE;
+    }
+
+    for (i = 0; i < terms->len; i++) {
+        const AlarmRuleTerm *t = &g_array_index(terms, AlarmRuleTerm, i);
+
+        if (t->required == required && t->forbidden == forbidden) {
+            return TRUE;
+        }
+    }
+
+    if (terms->len == MAX_TERMS) {
+        return FALSE;
+    }
+
+    g_array_append_val(terms, term);
+
+    return TRUE;
+}
+
+/**
+ * Terms of a AND b, NULL if too many
+ */
+static GArray *terms_and(const GArray *a, const GArray *b)
+{
+    GArray *ret = g_array_new(FALSE, FALSE, sizeof(AlarmRuleTerm));
+    guint i;
+    guint j;
+
+    for (i = 0; i < a->len; i++) {
+        const AlarmRuleTerm *x = &g_array_index(a, AlarmRuleTerm, i);
+
+        for (j = 0; j < b->len; j++) {
+            const AlarmRuleTerm *y = &g_array_index(b, AlarmRuleTerm, j);
+
+            if (!terms_add(ret, x->required | y->required,
+                x->forbidden | y->forbidden)) {
+                g_array_free(ret, TRUE);
+                return NULL;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Terms of a OR b, NULL if too many
+ */
+static GArray *terms_or(const GArray *a, const GArray *b)
+{
+    GArray *ret = g_array_new(FALSE, FALSE, sizeof(AlarmRuleTerm));
+    const GArray *both[] = { a, b };
+    guint i;
+    guint j;
+
+    for (i = 0; i < G_N_ELEMENTS(both); i++) {
+        for (j = 0; j < both[i]->len; j++) {
+            const AlarmRuleTerm *t = &g_array_index(both[i], AlarmRuleTerm,
+                j);
+
+            if (!terms_add(ret, t->required, t->forbidden)) {
+                g_array_free(ret, TRUE);
+                return NULL;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Terms of NOT a, NULL if too many
+ */
+static GArray *terms_not(const GArray *a)
+{
+    GArray *ret = g_array_new(FALSE, FALSE, sizeof(AlarmRuleTerm));
+    guint i;
+    guint bit;
+
+    /* Start from true, then AND in the negation of every term */
+    terms_add(ret, 0, 0);
+
+    for (i = 0; i < a->len && ret; i++) {
+        const AlarmRuleTerm *t = &g_array_index(a, AlarmRuleTerm, i);
+        GArray *negated = g_array_new(FALSE, FALSE, sizeof(AlarmRuleTerm));
+        GArray *next;
+        gboolean ok = TRUE;
+
+        /* NOT (a & !b) is !a | b */
+        for (bit = 0; bit < ALARM_RULE_MAX && ok; bit++) {
+            if (t->required & BIT(bit)) {
+                ok = terms_add(negated, 0, BIT(bit));
+            } else if (t->forbidden & BIT(bit)) {
+                ok = terms_add(negated, BIT(bit), 0);
+            }
+        }
+
+        next = ok ? terms_and(ret, negated) : NULL;
+
+        g_array_free(negated, TRUE);
+        g_array_free(ret, TRUE);
+        ret = next;
+    }
+
+    return ret;
+}
+
+/**
+ * Terms true when at least k of the count operands are, NULL if too many
+ */
+static GArray *terms_at_least(GArray **operands, guint count, guint k)
+{
+    GArray *ret;
+    guint *pick;
+    guint64 combinations = 1;
+    guint i;
+
+    /* C(count, k), every step is C(count - k + i, i) so it stays exact */
+    for (i = 1; i <= k; i++) {
+        combinations = combinations * (count - k + i) / i;
+
+        if (combinations > MAX_COMBINATIONS) {
+            return NULL;
+        }
+    }
+
+    ret = g_array_new(FALSE, FALSE, sizeof(AlarmRuleTerm));
+    pick = g_new(guint, k);
+
+    for (i = 0; i < k; i++) {
+        pick[i] = i;
+    }
+
+    /* OR over every combination of k operands ANDed together */
+    for (;;) {
+        GArray *combination = g_array_new(FALSE, FALSE,
+            sizeof(AlarmRuleTerm));
+        GArray *next;
+
+        terms_add(combination, 0, 0);
+
+        for (i = 0; i < k && combination; i++) {
+            next = terms_and(combination, operands[pick[i]]);
+            g_array_free(combination, TRUE);
+            combination = next;
+        }
+
+        next = combination ? terms_or(ret, combination) : NULL;
+
+        if (combination) {
+            g_array_free(combination, TRUE);
+        }
+
+        g_array_free(ret, TRUE);
+        ret = next;
+
+        if (!ret) {
+            break;
+        }
+
+        /* Advance to the next combination in lexical order */
+        for (i = k; i > 0 && pick[i - 1] == count - k + i - 1; i--) {
+        }
+
+        if (i == 0) {
+            break;
+        }
+
+        pick[i - 1]++;
+
+        for (; i < k; i++) {
+            pick[i] = pick[i - 1] + 1;
+        }
+    }
+
+    g_free(pick);
+
+    return ret;
+}
+
+/**
+ * Rewrite a program as OR of AND terms, NULL if it needs too many
+ */
+static GArray *terms_from_program(const GArray *program)
+{
+    GPtrArray *stack = g_ptr_array_new_with_free_func(
+        (GDestroyNotify) g_array_unref);
+    GArray *ret = NULL;
+    guint i;
+
+    for (i = 0; i < program->len; i++) {
+        const AlarmRuleInsn *insn = &g_array_index(program, AlarmRuleInsn, i);
+        guint top = stack->len;
+        GArray **args = (GArray **) stack->pdata;
+        GArray *result = NULL;
+        guint used = 0;
+
+        switch (insn->op) {
+        case OP_PUSH:
+            result = g_array_new(FALSE, FALSE, sizeof(AlarmRuleTerm));
+            terms_add(result, BIT(insn->index), 0);
+            break;
+        case OP_NOT:
+            result = terms_not(args[top - 1]);
+            used = 1;
+            break;
+        case OP_AND:
+            result = terms_and(args[top - 2], args[top - 1]);
+            used = 2;
+            break;
+        case OP_OR:
+            result = terms_or(args[top - 2], args[top - 1]);
+            used = 2;
+            break;
+        case OP_AT_LEAST:
+            result = terms_at_least(args + top - insn->count, insn->count,
+                insn->k);
+            used = insn->count;
+            break;
+        }
+
+        g_ptr_array_set_size(stack, top - used);
+
+        if (!result) {
+            g_ptr_array_free(stack, TRUE);
+            return NULL;
+        }
+
+        g_ptr_array_add(stack, result);
+    }
+
+    /* The one result left is handed over, not freed with the stack */
+    ret = g_ptr_array_index(stack, 0);
+    g_ptr_array_set_free_func(stack, NULL);
+    g_ptr_array_free(stack, TRUE);
+
+    return ret;
+}
+
+/**
+ * Run the program of a rule that could not be reduced to terms
+ */
+static gboolean run_program(const AlarmRule *rule, const GArray *program)
+{
+    const AlarmRuleInsn *insn = (const AlarmRuleInsn *) program->data;
+    const AlarmRuleInsn *end = insn + program->len;
+    gboolean *top = rule->stack - 1;
+
+    for (; insn < end; insn++) {
+        switch (insn->op) {
+        case OP_PUSH:
+            *++top = (rule->active & BIT(insn->index)) != 0;
+            break;
+        case OP_NOT:
+            *top = !*top;
+            break;
+        case OP_AND:
+            top--;
+            *top = *top && top[1];
+            break;
+        case OP_OR:
+            top--;
+            *top = *top || top[1];
+            break;
+        case OP_AT_LEAST: {
+            guint n = 0;
+            guint i;
+
+            top -= insn->count - 1;
+
+            for (i = 0; i < insn->count; i++) {
+                n += top[i] ? 1 : 0;
+            }
+
+            *top = n >= insn->k;
+            break;
+        }
+        }
+    }
+
+    return *top;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Compile one or more boolean expressions over APD scenario names and
+ * sequences, separated by ';'. NULL if any is invalid.
+ */
+AlarmRule *alarm_rule_new(const char *expression, const char *sequences)
+{
+    AlarmRule *rule = g_new0(AlarmRule, 1);
+    GPtrArray *sources = split_entries(sequences);
+    guint max_depth = 0;
+    guint i;
+
+    rule->scenarios = g_ptr_array_new_with_free_func(g_free);
+    rule->sequence_names = g_ptr_array_new_with_free_func(g_free);
+    rule->sequences = alarm_sequences_new();
+    rule->rules = g_array_new(FALSE, TRUE, sizeof(AlarmRuleEntry));
+    rule->terms = g_array_new(FALSE, FALSE, sizeof(AlarmRuleTerm));
+
+    /* Sequences first, so the rules can refer to them by name */
+    for (i = 0; i < sources->len; i++) {
+        if (!parse_sequence(rule, g_ptr_array_index(sources, i))) {
+            g_ptr_array_free(sources, TRUE);
+            alarm_rule_free(rule);
+            return NULL;
+        }
+    }
+
+    g_ptr_array_free(sources, TRUE);
+    sources = split_entries(expression);
+
+    if (sources->len == 0) {
+        ERR("Alarm rule '%s' has no expression",
+            expression ? expression : "");
+    }
+
+    for (i = 0; i < sources->len; i++) {
+        const char *source = g_ptr_array_index(sources, i);
+        AlarmRuleParser parser = { 0 };
+        AlarmRuleEntry entry = { 0 };
+        GArray *terms;
+
+        parser.p = source;
+        parser.rule = rule;
+        parser.program = g_array_new(FALSE, FALSE, sizeof(AlarmRuleInsn));
+
+        parse_or(&parser);
+        skip_space(&parser);
+
+        entry.expression = g_strdup(source);
+        entry.program = parser.program;
+        g_array_append_val(rule->rules, entry);
+
+        if (parser.failed || *parser.p != '\0') {
+            ERR("Invalid alarm rule '%s' at '%s'", source, parser.p);
+            break;
+        }
+
+        if (rule->rules->len > ALARM_RULE_MAX ||
+            rule->scenarios->len + rule->sequence_names->len >
+            ALARM_RULE_MAX) {
+            ERR("Alarm rules may use at most %d rules and %d scenarios",
+                ALARM_RULE_MAX, ALARM_RULE_MAX);
+            break;
+        }
+
+        max_depth = MAX(max_depth, parser.max_depth);
+
+        /* Most rules reduce to a few masks, others keep the program */
+        terms = terms_from_program(parser.program);
+
+        if (terms) {
+            AlarmRuleEntry *added = &g_array_index(rule->rules,
+                AlarmRuleEntry, rule->rules->len - 1);
+
+            added->masks = TRUE;
+            added->first_term = rule->terms->len;
+            added->n_terms = terms->len;
+
+            g_array_append_vals(rule->terms, terms->data, terms->len);
+            g_array_free(terms, TRUE);
+        }
+    }
+
+    if (sources->len == 0 || i < sources->len) {
+        g_ptr_array_free(sources, TRUE);
+        alarm_rule_free(rule);
+        return NULL;
+    }
+
+    g_ptr_array_free(sources, TRUE);
+
+    /* Allocated once so evaluation never allocates */
+    rule->stack = g_new0(gboolean, MAX(max_depth, 1));
+
+    return rule;
+}
+
+/**
+ * Free compiled rules
+ */
+void alarm_rule_free(AlarmRule *rule)
+{
+    guint i;
+
+    if (!rule) {
+        return;
+    }
+
+    for (i = 0; i < rule->rules->len; i++) {
+        AlarmRuleEntry *entry = &g_array_index(rule->rules, AlarmRuleEntry,
+            i);
+
+        g_free(entry->expression);
+        g_array_free(entry->program, TRUE);
+    }
+
+    g_ptr_array_free(rule->scenarios, TRUE);
+    g_ptr_array_free(rule->sequence_names, TRUE);
+    alarm_sequences_free(rule->sequences);
+    g_array_free(rule->rules, TRUE);
+    g_array_free(rule->terms, TRUE);
+    g_free(rule->stack);
+    g_free(rule);
+}
+
+/**
+ * Number of rules
+ */
+guint alarm_rule_count(const AlarmRule *rule)
+{
+    return rule->rules->len;
+}
+
+/**
+ * Number of distinct scenarios the rule refers to
+ */
+guint alarm_rule_scenario_count(const AlarmRule *rule)
+{
+    return rule->scenarios->len;
+}
+
+/**
+ * Name of a scenario by index, in order of first appearance
+ */
+const char *alarm_rule_scenario(const AlarmRule *rule, guint index)
+{
+    return g_ptr_array_index(rule->scenarios, index);
+}
+
+
+/**
+ * Update the state of a scenario by index at monotonic time now
+ */
+void alarm_rule_set(AlarmRule *rule, guint index, gboolean active,
+    gint64 now)
+{
+    guint64 changed;
+    guint sequence;
+
+    if (index >= rule->scenarios->len) {
+        return;
+    }
+
+    if (active) {
+        rule->active |= BIT(index);
+    } else {
+        rule->active &= ~BIT(index);
+    }
+
+    changed = alarm_sequences_update(rule->sequences, index, active, now,
+        &rule->sequence_states);
+
+    for (sequence = 0; changed; sequence++, changed >>= 1) {
+        if (!(changed & 1)) {
+            continue;
+        }
+
+        if (rule->sequence_states & BIT(sequence)) {
+            rule->active |= BIT(SEQUENCE_BIT(sequence));
+        } else {
+            rule->active &= ~BIT(SEQUENCE_BIT(sequence));
+        }
+    }
+}
+
+/**
+ * Evaluate all rules for the current scenario states, returns a mask
+ * with bit n set if rule n is true
+ */
+guint64 alarm_rule_evaluate(AlarmRule *rule)
+{
+    const AlarmRuleEntry *entries = (const AlarmRuleEntry *) rule->rules->data;
+    const AlarmRuleTerm *terms = (const AlarmRuleTerm *) rule->terms->data;
+    guint64 active = rule->active;
+    guint64 ret = 0;
+    guint i;
+
+    for (i = 0; i < rule->rules->len; i++) {
+        const AlarmRuleEntry *entry = &entries[i];
+        const AlarmRuleTerm *t = terms + entry->first_term;
+        const AlarmRuleTerm *end = t + entry->n_terms;
+
+        if (!entry->masks) {
+            ret |= run_program(rule, entry->program) ? BIT(i) : 0;
+            continue;
+        }
+
+        for (; t < end; t++) {
+            if ((active & t->required) == t->required &&
+                !(active & t->forbidden)) {
+                ret |= BIT(i);
+                break;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Write scenario and rule states as XML elements
+ */
+void alarm_rule_report(AlarmRule *rule, GString *xml)
+{
+    guint64 result = alarm_rule_evaluate(rule);
+    guint i;
+
+    for (i = 0; i < rule->scenarios->len; i++) {
+        gchar *element = g_markup_printf_escaped(
+            "<scenario name='%s' active='%d'/>",
+            (const char *) g_ptr_array_index(rule->scenarios, i),
+            (rule->active & BIT(i)) != 0);
+
+        g_string_append(xml, element);
+        g_free(element);
+    }
+
+    for (i = 0; i < rule->sequence_names->len; i++) {
+        gchar *element = g_markup_printf_escaped(
+            "<sequence name='%s' active='%d'/>",
+            (const char *) g_ptr_array_index(rule->sequence_names, i),
+            (rule->sequence_states & BIT(i)) != 0);
+
+        g_string_append(xml, element);
+        g_free(element);
+    }
+
+    for (i = 0; i < rule->rules->len; i++) {
+        const AlarmRuleEntry *entry = &g_array_index(rule->rules,
+            AlarmRuleEntry, i);
+        gchar *element = g_markup_printf_escaped(
+            "<rule expression='%s' active='%d' terms='%d'/>",
+            entry->expression, (result & BIT(i)) != 0,
+            entry->masks ? (int) entry->n_terms : -1);
+
+        g_string_append(xml, element);
+        g_free(element);
+    }
+}
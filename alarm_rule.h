@@ -0,0 +1,67 @@
+#ifndef INCLUSION_GUARD_ALARM_RULE_H
+#define INCLUSION_GUARD_ALARM_RULE_H
+
+/**
+ * Most scenarios, and most rules, in one compiled set
+ */
+#define ALARM_RULE_MAX      64
+
+/**
+ * Compiled combined alarm rules with the state of their scenarios
+ */
+typedef struct AlarmRule AlarmRule;
+
+/**
+ * Compile one or more boolean expressions over APD scenario names and
+ * sequences, separated by ';'. NULL if any is invalid. Operators are '!'
+ * (not), '&' (and), '|' (or), parentheses and "<k> of (<expr>, ...)", true
+ * when at least k operands are. Names with other characters than letters,
+ * digits, '-', '_' and '.' are written in double quotes. Empty entries
+ * between ';' are skipped.
+ *
+ * sequences holds "<name> = <scenario> then <scenario> ... within <ms>"
+ * entries separated by ';'. A sequence is true once its scenarios became
+ * active in that order within the time window, until its last scenario
+ * turns inactive. All scenarios start inactive.
+ */
+AlarmRule *alarm_rule_new(const char *expression, const char *sequences);
+
+/**
+ * Free compiled rules
+ */
+void alarm_rule_free(AlarmRule *rule);
+
+/**
+ * Number of rules
+ */
+guint alarm_rule_count(const AlarmRule *rule);
+
+/**
+ * Number of distinct scenarios the rules and sequences refer to
+ */
+guint alarm_rule_scenario_count(const AlarmRule *rule);
+
+/**
+ * Name of a scenario by index, in order of first appearance
+ */
+const char *alarm_rule_scenario(const AlarmRule *rule, guint index);
+
+/**
+ * Update the state of a scenario by index at monotonic time now, in
+ * microseconds
+ */
+void alarm_rule_set(AlarmRule *rule, guint index, gboolean active,
+    gint64 now);
+
+/**
+ * Evaluate all rules for the current scenario states, returns a mask
+ * with bit n set if rule n is true
+ */
+guint64 alarm_rule_evaluate(AlarmRule *rule);
+
+/**
+ * Write scenario and rule states as XML elements
+ */
+void alarm_rule_report(AlarmRule *rule, GString *xml);
+
+#endif // INCLUSION_GUARD_ALARM_RULE_H
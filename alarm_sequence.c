@@ -0,0 +1,234 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "alarm_sequence.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   { syslog(LOG_INFO, fmt, ## args); \
+    g_message(fmt, ## args); }
+
+/**
+ * Most sequences in one set, one bit each
+ */
+#define MAX_SEQUENCES       64
+
+/**
+ * Bit of a sequence in a state mask
+ */
+#define BIT(index)          (G_GUINT64_CONSTANT(1) << (index))
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Reference from a scenario to a step of a sequence using it
+ */
+typedef struct {
+    guint sequence;
+    guint step;
+} AlarmStepRef;
+
+/**
+ * Ordered sequence and its matching progress. started[k] is the start
+ * time of the latest partial match that has reached step k, or -1.
+ */
+typedef struct {
+    guint *steps;
+    gint64 *started;
+    guint n_steps;
+    gint64 window;
+} AlarmSequence;
+
+/**
+ * Ordered scenario sequences. Each step keeps only the start of its newest
+ * partial match, so no history of activations is needed to match.
+ */
+struct AlarmSequences {
+    GArray *sequences;
+    GArray *refs;
+};
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Step references of a scenario, allocated on first use
+ */
+static GArray *scenario_refs(AlarmSequences *sequences, guint scenario);
+
+/**
+ * Advance the partial matches of a sequence on activation of a step
+ */
+static gboolean advance(AlarmSequence *seq, guint step, gint64 now);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Step references of a scenario, allocated on first use
+ */
+static GArray *scenario_refs(AlarmSequences *sequences, guint scenario)
+{
+    GArray **refs;
+
+    if (scenario >= sequences->refs->len) {
+        g_array_set_size(sequences->refs, scenario + 1);
+    }
+
+    refs = &g_array_index(sequences->refs, GArray *, scenario);
+
+    if (!*refs) {
+        *refs = g_array_new(FALSE, FALSE, sizeof(AlarmStepRef));
+    }
+
+    return *refs;
+}
+
+/**
+ * Advance the partial matches of a sequence on activation of a step
+ */
+static gboolean advance(AlarmSequence *seq, guint step, gint64 now)
+{
+    if (step == 0) {
+        seq->started[0] = now;
+    } else if (seq->started[step - 1] >= 0 &&
+        now - seq->started[step - 1] <= seq->window) {
+        seq->started[step] = seq->started[step - 1];
+    } else {
+        return FALSE;
+    }
+
+    return step == seq->n_steps - 1;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Create an empty set of sequences
+ */
+AlarmSequences *alarm_sequences_new()
+{
+    AlarmSequences *sequences = g_new0(AlarmSequences, 1);
+
+    sequences->sequences = g_array_new(FALSE, FALSE, sizeof(AlarmSequence));
+    sequences->refs = g_array_new(FALSE, TRUE, sizeof(GArray *));
+
+    return sequences;
+}
+
+/**
+ * Free a set of sequences
+ */
+void alarm_sequences_free(AlarmSequences *sequences)
+{
+    guint i;
+
+    if (!sequences) {
+        return;
+    }
+
+    for (i = 0; i < sequences->sequences->len; i++) {
+        AlarmSequence *seq = &g_array_index(sequences->sequences,
+            AlarmSequence, i);
+
+        g_free(seq->steps);
+        g_free(seq->started);
+    }
+
+    for (i = 0; i < sequences->refs->len; i++) {
+        GArray *refs = g_array_index(sequences->refs, GArray *, i);
+
+        if (refs) {
+            g_array_free(refs, TRUE);
+        }
+    }
+
+    g_array_free(sequences->sequences, TRUE);
+    g_array_free(sequences->refs, TRUE);
+    g_free(sequences);
+}
+
+/**
+ * Add a sequence of scenario indices that must become active in order
+ * within window microseconds, returns the sequence index
+ */
+guint alarm_sequences_add(AlarmSequences *sequences, const guint *steps,
+    guint n_steps, gint64 window)
+{
+    AlarmSequence seq;
+    guint index = sequences->sequences->len;
+    guint i;
+
+    g_return_val_if_fail(n_steps > 0 && index < MAX_SEQUENCES, index);
+
+    seq.steps = g_memdup(steps, n_steps * sizeof(guint));
+    seq.started = g_new(gint64, n_steps);
+    seq.n_steps = n_steps;
+    seq.window = window;
+
+    for (i = 0; i < n_steps; i++) {
+        AlarmStepRef ref = { index, i };
+
+        seq.started[i] = -1;
+
+        /* Later steps first, so one activation advances a step only once */
+        g_array_prepend_val(scenario_refs(sequences, steps[i]), ref);
+    }
+
+    g_array_append_val(sequences->sequences, seq);
+
+    return index;
+}
+
+/**
+ * Number of sequences
+ */
+guint alarm_sequences_count(const AlarmSequences *sequences)
+{
+    return sequences->sequences->len;
+}
+
+/**
+ * Feed a scenario state change at monotonic time now (microseconds).
+ * Returns a mask of the sequences whose state changed and updates their
+ * bits in states.
+ */
+guint64 alarm_sequences_update(AlarmSequences *sequences, guint scenario,
+    gboolean active, gint64 now, guint64 *states)
+{
+    GArray *refs;
+    guint64 changed = 0;
+    guint i;
+
+    if (scenario >= sequences->refs->len ||
+        !(refs = g_array_index(sequences->refs, GArray *, scenario))) {
+        return 0;
+    }
+
+    /* Only the sequences that use this scenario are touched */
+    for (i = 0; i < refs->len; i++) {
+        const AlarmStepRef *ref = &g_array_index(refs, AlarmStepRef, i);
+        AlarmSequence *seq = &g_array_index(sequences->sequences,
+            AlarmSequence, ref->sequence);
+        gboolean last = ref->step == seq->n_steps - 1;
+        guint64 bit = BIT(ref->sequence);
+
+        if (active && advance(seq, ref->step, now) && !(*states & bit)) {
+            LOG("Sequence %u completed", ref->sequence);
+            *states |= bit;
+            changed |= bit;
+        } else if (!active && last && (*states & bit)) {
+            /* Completed sequences hold while their last scenario does */
+            *states &= ~bit;
+            changed |= bit;
+        }
+    }
+
+    return changed;
+}
@@ -0,0 +1,40 @@
+#ifndef INCLUSION_GUARD_ALARM_SEQUENCE_H
+#define INCLUSION_GUARD_ALARM_SEQUENCE_H
+
+/**
+ * Ordered scenario sequences, each one true once its scenarios became
+ * active in order within its time window
+ */
+typedef struct AlarmSequences AlarmSequences;
+
+/**
+ * Create an empty set of sequences
+ */
+AlarmSequences *alarm_sequences_new();
+
+/**
+ * Free a set of sequences
+ */
+void alarm_sequences_free(AlarmSequences *sequences);
+
+/**
+ * Add a sequence of scenario indices that must become active in order
+ * within window microseconds, returns the sequence index
+ */
+guint alarm_sequences_add(AlarmSequences *sequences, const guint *steps,
+    guint n_steps, gint64 window);
+
+/**
+ * Number of sequences
+ */
+guint alarm_sequences_count(const AlarmSequences *sequences);
+
+/**
+ * Feed a scenario state change at monotonic time now (microseconds).
+ * Changes must be fed in time order. Returns a mask of the sequences whose
+ * state changed and updates their bits in states.
+ */
+guint64 alarm_sequences_update(AlarmSequences *sequences, guint scenario,
+    gboolean active, gint64 now, guint64 *states);
+
+#endif // INCLUSION_GUARD_ALARM_SEQUENCE_H
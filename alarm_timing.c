@@ -0,0 +1,389 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "alarm_timing.h"
+#include "timer_wheel.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   { syslog(LOG_INFO, fmt, ## args); \
+    g_message(fmt, ## args); }
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
+    g_warning(fmt, ## args); }
+
+/**
+ * Bit of a rule in the result and output masks
+ */
+#define BIT(i)              ((guint64) 1 << (i))
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Timing state of one rule, timers only exist for non-zero times
+ */
+typedef struct {
+    AlarmTiming *timing;
+    guint index;
+    guint dwell;
+    guint holdoff;
+    guint autoclear;
+    gboolean result;
+    gboolean armed;
+    gboolean latched;
+    TimerWheelTimer *dwell_timer;
+    TimerWheelTimer *holdoff_timer;
+    TimerWheelTimer *autoclear_timer;
+} AlarmTimingRule;
+
+/**
+ * Dwell, hold-off and auto-clear filtering of alarm rule results
+ */
+struct AlarmTiming {
+    AlarmTimingRule *rules;
+    guint count;
+    guint64 outputs;
+    guint64 reported;
+    AlarmTimingCallback callback;
+    gpointer user_data;
+};
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Parse "<dwell>,<hold-off>,<auto-clear>" into a rule, FALSE if invalid
+ */
+static gboolean parse_entry(AlarmTimingRule *rule, const char *entry);
+
+/**
+ * Report the outputs if they changed since last time
+ */
+static void notify(AlarmTiming *timing);
+
+/**
+ * Turn a rule output on if nothing holds it back
+ */
+static void try_on(AlarmTimingRule *rule);
+
+/**
+ * Turn a rule output off and start its hold-off
+ */
+static void turn_off(AlarmTimingRule *rule);
+
+/**
+ * Timer callback, the rule has been true for its dwell time
+ */
+static void on_dwell(gpointer user_data);
+
+/**
+ * Timer callback, the hold-off after the rule output turned off is over
+ */
+static void on_holdoff(gpointer user_data);
+
+/**
+ * Timer callback, the rule output has been on for its auto-clear time
+ */
+static void on_autoclear(gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Parse "<dwell>,<hold-off>,<auto-clear>" into a rule, FALSE if invalid
+ */
+static gboolean parse_entry(AlarmTimingRule *rule, const char *entry)
+{
+    guint *fields[] = { &rule->dwell, &rule->holdoff, &rule->autoclear };
+    gchar **values = g_strsplit(entry, ",", -1);
+    gboolean ok = g_strv_length(values) <= G_N_ELEMENTS(fields);
+    guint i;
+
+    for (i = 0; ok && values[i]; i++) {
+        gchar *value = g_strstrip(values[i]);
+        gchar *end;
+        guint64 ms;
+
+        if (*value == '\0') {
+            continue;
+        }
+
+        ms = g_ascii_strtoull(value, &end, 10);
+        ok = *end == '\0' && ms <= G_MAXUINT;
+        *fields[i] = ms;
+    }
+
+    g_strfreev(values);
+
+    return ok;
+}
+
+/**
+ * Report the outputs if they changed since last time
+ */
+static void notify(AlarmTiming *timing)
+{
+    if (timing->outputs != timing->reported) {
+        timing->reported = timing->outputs;
+        timing->callback(timing->outputs, timing->user_data);
+    }
+}
+
+/**
+ * Turn a rule output on if nothing holds it back
+ */
+static void try_on(AlarmTimingRule *rule)
+{
+    AlarmTiming *timing = rule->timing;
+
+    if (!rule->result || !rule->armed || rule->latched ||
+        (timing->outputs & BIT(rule->index)) ||
+        (rule->holdoff_timer && timer_wheel_pending(rule->holdoff_timer))) {
+        return;
+    }
+
+    timing->outputs |= BIT(rule->index);
+
+    if (rule->autoclear_timer) {
+        timer_wheel_start(rule->autoclear_timer, rule->autoclear);
+    }
+}
+
+/**
+ * Turn a rule output off and start its hold-off
+ */
+static void turn_off(AlarmTimingRule *rule)
+{
+    AlarmTiming *timing = rule->timing;
+
+    if (!(timing->outputs & BIT(rule->index))) {
+        return;
+    }
+
+    timing->outputs &= ~BIT(rule->index);
+
+    if (rule->autoclear_timer) {
+        timer_wheel_cancel(rule->autoclear_timer);
+    }
+
+    if (rule->holdoff_timer) {
+        timer_wheel_start(rule->holdoff_timer, rule->holdoff);
+    }
+}
+
+/**
+ * Timer callback, the rule has been true for its dwell time
+ */
+static void on_dwell(gpointer user_data)
+{
+    AlarmTimingRule *rule = user_data;
+
+    rule->armed = TRUE;
+    try_on(rule);
+    notify(rule->timing);
+}
+
+/**
+ * Timer callback, the hold-off after the rule output turned off is over
+ */
+static void on_holdoff(gpointer user_data)
+{
+    AlarmTimingRule *rule = user_data;
+
+    try_on(rule);
+    notify(rule->timing);
+}
+
+/**
+ * Timer callback, the rule output has been on for its auto-clear time
+ */
+static void on_autoclear(gpointer user_data)
+{
+    AlarmTimingRule *rule = user_data;
+
+    LOG("Auto-clearing alarm rule %u", rule->index);
+
+    rule->latched = TRUE;
+    turn_off(rule);
+    notify(rule->timing);
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Parse timing for count rules, one entry per rule separated by ';'.
+ */
+AlarmTiming *alarm_timing_new(const char *spec, guint count,
+    AlarmTimingCallback callback, gpointer user_data)
+{
+    AlarmTiming *timing = g_new0(AlarmTiming, 1);
+    gchar **entries = g_strsplit(spec ? spec : "", ";", -1);
+    guint n_entries = g_strv_length(entries);
+    guint i;
+
+    timing->rules = g_new0(AlarmTimingRule, count);
+    timing->count = count;
+    timing->callback = callback;
+    timing->user_data = user_data;
+
+    if (n_entries > count) {
+        ERR("Alarm timing '%s' has more entries than the %u rules", spec,
+            count);
+        g_strfreev(entries);
+        alarm_timing_free(timing);
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        AlarmTimingRule *rule = &timing->rules[i];
+
+        rule->timing = timing;
+        rule->index = i;
+
+        if (i < n_entries && !parse_entry(rule, entries[i])) {
+            ERR("Invalid alarm timing '%s', expected <dwell>,<hold-off>,"
+                "<auto-clear> in ms", entries[i]);
+            g_strfreev(entries);
+            alarm_timing_free(timing);
+            return NULL;
+        }
+
+        if (rule->dwell) {
+            rule->dwell_timer = timer_wheel_timer_new(on_dwell, rule);
+        }
+
+        if (rule->holdoff) {
+            rule->holdoff_timer = timer_wheel_timer_new(on_holdoff, rule);
+        }
+
+        if (rule->autoclear) {
+            rule->autoclear_timer = timer_wheel_timer_new(on_autoclear, rule);
+        }
+    }
+
+    g_strfreev(entries);
+
+    return timing;
+}
+
+/**
+ * Carry the results, latches and outputs of the rules that exist in both
+ * from a previous timing.
+ */
+void alarm_timing_inherit(AlarmTiming *timing, const AlarmTiming *previous)
+{
+    guint count = MIN(timing->count, previous->count);
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        AlarmTimingRule *rule = &timing->rules[i];
+        const AlarmTimingRule *old = &previous->rules[i];
+
+        rule->result = old->result;
+        rule->latched = old->latched;
+
+        if (previous->outputs & BIT(i)) {
+            rule->armed = TRUE;
+            timing->outputs |= BIT(i);
+
+            if (rule->autoclear_timer) {
+                timer_wheel_start(rule->autoclear_timer, rule->autoclear);
+            }
+        } else if (rule->result && !rule->latched) {
+            /* Still waiting for the dwell or the hold-off to pass */
+            if (!old->armed && rule->dwell_timer) {
+                timer_wheel_start(rule->dwell_timer, rule->dwell);
+            } else {
+                rule->armed = TRUE;
+
+                if (old->holdoff_timer &&
+                    timer_wheel_pending(old->holdoff_timer) &&
+                    rule->holdoff_timer) {
+                    timer_wheel_start(rule->holdoff_timer, rule->holdoff);
+                }
+
+                try_on(rule);
+            }
+        }
+    }
+
+    timing->reported = previous->reported;
+    notify(timing);
+}
+
+/**
+ * Free the timing state and stop its timers
+ */
+void alarm_timing_free(AlarmTiming *timing)
+{
+    guint i;
+
+    if (!timing) {
+        return;
+    }
+
+    for (i = 0; i < timing->count; i++) {
+        timer_wheel_timer_free(timing->rules[i].dwell_timer);
+        timer_wheel_timer_free(timing->rules[i].holdoff_timer);
+        timer_wheel_timer_free(timing->rules[i].autoclear_timer);
+    }
+
+    g_free(timing->rules);
+    g_free(timing);
+}
+
+/**
+ * Feed the current rule results, one bit per rule.
+ */
+void alarm_timing_update(AlarmTiming *timing, guint64 results)
+{
+    guint i;
+
+    for (i = 0; i < timing->count; i++) {
+        AlarmTimingRule *rule = &timing->rules[i];
+        gboolean result = (results & BIT(i)) != 0;
+
+        if (result == rule->result) {
+            continue;
+        }
+
+        rule->result = result;
+        rule->latched = FALSE;
+
+        if (result) {
+            if (rule->dwell_timer) {
+                timer_wheel_start(rule->dwell_timer, rule->dwell);
+            } else {
+                rule->armed = TRUE;
+                try_on(rule);
+            }
+        } else {
+            rule->armed = FALSE;
+
+            if (rule->dwell_timer) {
+                timer_wheel_cancel(rule->dwell_timer);
+            }
+
+            turn_off(rule);
+        }
+    }
+
+    notify(timing);
+}
+
+/**
+ * Current rule outputs, one bit per rule
+ */
+guint64 alarm_timing_outputs(const AlarmTiming *timing)
+{
+    return timing->outputs;
+}
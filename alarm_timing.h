@@ -0,0 +1,51 @@
+#ifndef INCLUSION_GUARD_ALARM_TIMING_H
+#define INCLUSION_GUARD_ALARM_TIMING_H
+
+/**
+ * Called from the main loop when the mask of active rule outputs changes
+ */
+typedef void (*AlarmTimingCallback)(guint64 outputs, gpointer user_data);
+
+/**
+ * Dwell, hold-off and auto-clear filtering of alarm rule results
+ */
+typedef struct AlarmTiming AlarmTiming;
+
+/**
+ * Parse timing for count rules from "<dwell>,<hold-off>,<auto-clear>"
+ * entries in milliseconds, one per rule separated by ';'. Missing entries
+ * and fields are 0. NULL if invalid.
+ *
+ * A rule output turns on once the rule has been true for the dwell time,
+ * but not within the hold-off time after it last turned off. It turns off
+ * when the rule turns false or after the auto-clear time, and then stays
+ * off until the rule has been false.
+ */
+AlarmTiming *alarm_timing_new(const char *spec, guint count,
+    AlarmTimingCallback callback, gpointer user_data);
+
+/**
+ * Carry the results, latches and outputs of the rules that exist in both
+ * from a previous timing, so a rule change does not flip outputs that are
+ * already on or fire auto-clear again. Running times start over. Nothing
+ * is reported for outputs that are unchanged.
+ */
+void alarm_timing_inherit(AlarmTiming *timing, const AlarmTiming *previous);
+
+/**
+ * Free the timing state and stop its timers
+ */
+void alarm_timing_free(AlarmTiming *timing);
+
+/**
+ * Feed the current rule results, one bit per rule. Outputs that change
+ * right away are reported through the callback before this returns.
+ */
+void alarm_timing_update(AlarmTiming *timing, guint64 results);
+
+/**
+ * Current rule outputs, one bit per rule
+ */
+guint64 alarm_timing_outputs(const AlarmTiming *timing);
+
+#endif // INCLUSION_GUARD_ALARM_TIMING_H
@@ -0,0 +1,131 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "asset_cache.h"
+#include "overlay_commands.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   { syslog(LOG_INFO, fmt, ## args); \
+    g_message(fmt, ## args); }
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
+    g_warning(fmt, ## args); }
+
+/**
+ * Key file group holding one "<ovl name>=<hash>" entry per asset
+ */
+#define CACHE_GROUP         "Overlays"
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Cache contents, NULL until asset_cache_init()
+ */
+static GKeyFile *cache = NULL;
+
+/**
+ * File the cache is persisted to
+ */
+static gchar *cache_path = NULL;
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Load the asset cache from file, creating its directory if needed
+ */
+void asset_cache_init(const char *path)
+{
+    gchar *dir;
+
+    asset_cache_cleanup();
+
+    cache = g_key_file_new();
+    cache_path = g_strdup(path);
+
+    dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+
+    /* A missing file just means nothing has been uploaded yet */
+    g_key_file_load_from_file(cache, cache_path, G_KEY_FILE_NONE, NULL);
+}
+
+/**
+ * Free the asset cache
+ */
+void asset_cache_cleanup()
+{
+    if (cache) {
+        g_key_file_free(cache);
+        cache = NULL;
+    }
+
+    g_free(cache_path);
+    cache_path = NULL;
+}
+
+/**
+ * Content hash of a buffer, free with g_free()
+ */
+gchar *asset_cache_hash(const void *data, gsize length)
+{
+    return g_compute_checksum_for_data(G_CHECKSUM_SHA256, data, length);
+}
+
+/**
+ * TRUE if the overlay was uploaded with this hash and still exists
+ */
+gboolean asset_cache_is_current(const char *ovl_name, const char *hash)
+{
+    gchar *stored;
+    gchar *ovl_path;
+    gboolean ret;
+
+    if (!cache || !hash) {
+        return FALSE;
+    }
+
+    stored = g_key_file_get_string(cache, CACHE_GROUP, ovl_name, NULL);
+    ovl_path = g_build_filename(OVERLAY_DIR, ovl_name, NULL);
+
+    /* The device may have been reset since, so check the file as well */
+    ret = g_strcmp0(stored, hash) == 0 &&
+        g_file_test(ovl_path, G_FILE_TEST_IS_REGULAR);
+
+    g_free(stored);
+    g_free(ovl_path);
+
+    return ret;
+}
+
+/**
+ * Record that the overlay now exists with the given content hash
+ */
+void asset_cache_store(const char *ovl_name, const char *hash)
+{
+    GError *error = NULL;
+
+    if (!cache) {
+        return;
+    }
+
+    g_key_file_set_string(cache, CACHE_GROUP, ovl_name, hash);
+
+    if (!g_key_file_save_to_file(cache, cache_path, &error)) {
+        ERR("Failed to save asset cache %s: %s", cache_path, error->message);
+        g_error_free(error);
+    }
+}
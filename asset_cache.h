@@ -0,0 +1,29 @@
+#ifndef INCLUSION_GUARD_ASSET_CACHE_H
+#define INCLUSION_GUARD_ASSET_CACHE_H
+
+/**
+ * Load the asset cache from file, creating its directory if needed
+ */
+void asset_cache_init(const char *path);
+
+/**
+ * Free the asset cache
+ */
+void asset_cache_cleanup();
+
+/**
+ * Content hash of a buffer, free with g_free()
+ */
+gchar *asset_cache_hash(const void *data, gsize length);
+
+/**
+ * TRUE if the overlay was uploaded with this hash and still exists
+ */
+gboolean asset_cache_is_current(const char *ovl_name, const char *hash);
+
+/**
+ * Record that the overlay now exists with the given content hash
+ */
+void asset_cache_store(const char *ovl_name, const char *hash);
+
+#endif // INCLUSION_GUARD_ASSET_CACHE_H
@@ -19,6 +19,7 @@ AXParameter    *handler_application_param = 0;
 GHashTable     *table_application_cgi = 0; 
 GHashTable     *table_application_param = 0; 
 GHashTable     *table_application_event = 0; 
+GPtrArray      *array_application_event = 0;
 gchar          *string_application_id = 0;
 gchar          *string_application_name = 0;
 
@@ -28,6 +29,7 @@ typedef struct
   int   value;
   int   flags;
   char  data_id[32];
+  AXEventKeyValueSet *template;  // Data keys of the event, updated in place on every send
 } CAMERA_EVENT_PROPERTIES;
 
 typedef struct 
@@ -47,6 +49,7 @@ void camera_param_init();
 void camera_http_cleanup();
 void camera_event_cleanup();
 void camera_param_cleanup();
+void camera_event_free(gpointer props);
 
 
 void camera_init( const char* app_name_ID, const char* app_nicename)
@@ -238,23 +241,40 @@ camera_event_init()
     handler_application_event = ax_event_handler_new();
   
   if( !table_application_event )
-    table_application_event = g_hash_table_new_full(g_str_hash, g_str_equal,g_free, g_free);
+    table_application_event = g_hash_table_new_full(g_str_hash, g_str_equal,g_free, NULL);
+
+  if( !array_application_event )
+    array_application_event = g_ptr_array_new_with_free_func(camera_event_free);
+}
+
+void
+camera_event_free(gpointer data)
+{
+  CAMERA_EVENT_PROPERTIES *props = data;
+
+  if( props->template )
+    ax_event_key_value_set_free( props->template );
+  g_free( props );
 }
 
 void
 camera_event_cleanup()
 {
-  GHashTableIter iter;
   CAMERA_EVENT_PROPERTIES *props;
-  gchar *event_name;
+  guint i;
 
-  if( table_application_event ) {
+  if( array_application_event ) {
 
-    g_hash_table_iter_init(&iter, table_application_event);
-    while (g_hash_table_iter_next(&iter, (gpointer*)&event_name, (gpointer*)&props)) {
+    for( i = 0; i < array_application_event->len; i++ ) {
+      props = g_ptr_array_index( array_application_event, i );
       ax_event_handler_undeclare( handler_application_event,props->declaration_id,NULL);
     }
 
+    g_ptr_array_free( array_application_event, TRUE );
+    array_application_event = 0;
+  }
+
+  if( table_application_event ) {
     g_hash_table_destroy( table_application_event );
     table_application_event = 0;
   } 
@@ -278,12 +298,13 @@ camera_event_add(const char* event_id,
     LOG_ERROR("Camera: Cannot register event %s (handler not initialized)\n", event_name);
     return 0;
   }
-  //Define the event properties (used by function camera_event_send() )
+  //Define the event properties (used by function camera_event_sendByHandle() )
   props = (CAMERA_EVENT_PROPERTIES*)g_malloc(sizeof(CAMERA_EVENT_PROPERTIES));
   props->declaration_id = 0;
   props->flags = flags;
   props->value = 0;
   props->data_id[0] = 0;
+  props->template = 0;
 
   set = ax_event_key_value_set_new();
 
@@ -307,7 +328,7 @@ camera_event_add(const char* event_id,
   ax_event_key_value_set_mark_as_data(set, "active", NULL, NULL);
 
   if( data_id ) {
-    strcpy( props->data_id, data_id );
+    g_strlcpy( props->data_id, data_id, sizeof(props->data_id) );
     ax_event_key_value_set_add_key_value(set, data_id, NULL, "" , AX_VALUE_TYPE_STRING,NULL);
     ax_event_key_value_set_mark_as_data(set, data_id, NULL, NULL);
   }
@@ -320,69 +341,90 @@ camera_event_add(const char* event_id,
       NULL))  //No error handler
   {
     LOG_ERROR("Camera: Cannot declare event %s (internal error)\n",event_id);
+    ax_event_key_value_set_free(set);
     g_free( props );
     return 0;
   }
-  g_hash_table_insert(table_application_event, g_strdup( event_id ), (gpointer*)props);
-  return 1;
+  ax_event_key_value_set_free(set);
+
+  //Sends only carry the data keys, build them once and update the values in place
+  props->template = ax_event_key_value_set_new();
+  if( flags & EVENT_STATEFUL )
+    ax_event_key_value_set_add_key_value(props->template,"active", NULL, &(props->value) , AX_VALUE_TYPE_BOOL,NULL);
+  else
+    ax_event_key_value_set_add_key_value(props->template,"active", NULL, &(props->value) , AX_VALUE_TYPE_INT,NULL);
+  if( props->data_id[0] )
+    ax_event_key_value_set_add_key_value(props->template, props->data_id, NULL, "" , AX_VALUE_TYPE_STRING,NULL);
+
+  g_ptr_array_add( array_application_event, props );
+  g_hash_table_insert(table_application_event, g_strdup( event_id ), GINT_TO_POINTER( array_application_event->len ));
+  return array_application_event->len;
 }
 
 int
 camera_event_send(const char* event_id,int value, const char* event_data)
 {
-  AXEventKeyValueSet       *set = NULL;
-  AXEvent                  *event = NULL;
-  CAMERA_EVENT_PROPERTIES  *props;
-  GTimeVal                  time_stamp;
-  
-  if( !handler_application_event ) {
-    LOG_ERROR("Camera: Cannot send event %s. Handler is not initialized\n", event_id);
-    return 0;
-  }
-  
+  gpointer handle;
+
   if( !table_application_event ) {
     LOG_ERROR("Camera: Cannot send event %s. No events are registered\n", event_id);
     return 0;
   }
 
-  if(!g_hash_table_lookup_extended(table_application_event,event_id, NULL, (gpointer*)&props)) {
+  if(!g_hash_table_lookup_extended(table_application_event,event_id, NULL, &handle)) {
     LOG_ERROR("Camera: Cannot send event %s.  Event is not registered\n", event_id);
     return 0;
   }
 
-  if( props == 0 ) {
-    LOG_ERROR("Camera: Cannot send event %s. Event properties = NULL\n", event_id);
+  return camera_event_sendByHandle( GPOINTER_TO_INT( handle ), value, event_data );
+}
+
+int
+camera_event_sendByHandle(int handle,int value, const char* event_data)
+{
+  AXEvent                  *event = NULL;
+  CAMERA_EVENT_PROPERTIES  *props;
+  GTimeVal                  time_stamp;
+  
+  if( !handler_application_event ) {
+    LOG_ERROR("Camera: Cannot send event %d. Handler is not initialized\n", handle);
+    return 0;
+  }
+  
+  if( !array_application_event || handle < 1 || handle > (int)array_application_event->len ) {
+    LOG_ERROR("Camera: Cannot send event %d.  Event is not registered\n", handle);
     return 0;
   }
 
-  set = ax_event_key_value_set_new();
+  props = g_ptr_array_index( array_application_event, handle - 1 );
   props->value = value;
 
+  //Adding an existing key replaces its value, the template keeps its layout
   if( props->flags & EVENT_STATEFUL ) {  //Non stateful events use INT type
-    if( !ax_event_key_value_set_add_key_value(set,"active",NULL, &props->value,AX_VALUE_TYPE_BOOL,NULL) ) {
-      ax_event_key_value_set_free(set);
-      LOG_ERROR("Camera: Could not send event %s.  Internal error\n", event_id);
+    if( !ax_event_key_value_set_add_key_value(props->template,"active",NULL, &props->value,AX_VALUE_TYPE_BOOL,NULL) ) {
+      LOG_ERROR("Camera: Could not send event %d.  Internal error\n", handle);
+      return 0;
     }
   } else {
-    if( !ax_event_key_value_set_add_key_value(set,"active",NULL, &props->value,AX_VALUE_TYPE_INT,NULL) ) {
-      ax_event_key_value_set_free(set);
-      LOG_ERROR("Camera: Could not send event %s.  Internal error\n", event_id);
+    if( !ax_event_key_value_set_add_key_value(props->template,"active",NULL, &props->value,AX_VALUE_TYPE_INT,NULL) ) {
+      LOG_ERROR("Camera: Could not send event %d.  Internal error\n", handle);
+      return 0;
     }
   }
 
-  if( event_data && strlen( props->data_id ) ) {
-    if( !ax_event_key_value_set_add_key_value(set,props->data_id, NULL, event_data ,AX_VALUE_TYPE_STRING, NULL) )  {
-      ax_event_key_value_set_free(set);
-      LOG_ERROR("Camera: Could not send event %s.  Internal error\n", event_id);
+  //Without data the key goes back to its declared empty value, not the previous send
+  if( props->data_id[0] ) {
+    if( !ax_event_key_value_set_add_key_value(props->template,props->data_id, NULL, event_data ? event_data : "" ,AX_VALUE_TYPE_STRING, NULL) )  {
+      LOG_ERROR("Camera: Could not send event %d.  Internal error\n", handle);
+      return 0;
     }
   }
 
   g_get_current_time(&time_stamp);
-  event = ax_event_new(set, &time_stamp);
-  ax_event_key_value_set_free(set);
+  event = ax_event_new(props->template, &time_stamp);
 
   if( !ax_event_handler_send_event(handler_application_event, props->declaration_id, event, NULL) )  {
-    LOG_ERROR("Camera: Could not send event %s (id %d)\n", event_id, props->declaration_id);
+    LOG_ERROR("Camera: Could not send event %d (id %d)\n", handle, props->declaration_id);
     ax_event_free(event);
     return 0;
   }
@@ -59,7 +59,11 @@ int  camera_event_add(const char* event_id,   // A unique name for the event. Us
                       const char* event_name, // A nice name an application may display to the installer or operator
                       int event_flags,        // Use appropriate flags. See definutions for flags EVENT_XXXXXX.  
                       const char *data_id);   // The data attribute id name.  Set to null if no user data is passed
+            //Returns a handle for camera_event_sendByHandle() or 0 if the event could not be declared
 int  camera_event_send(const char* event_id,int value,const char* event_data);
+            //Looks the event up by name, prefer camera_event_sendByHandle() for frequent events
+int  camera_event_sendByHandle(int handle,int value,const char* event_data);
+            //Sends through the prebuilt key-value set of the event, no lookup or set allocation
 
 int  camera_param_setCallback(const char* name, CAMERA_PARAM_callback theCallback);
 const char* camera_param_get(const char* name, char *return_value, int max_count); //Returns the pointer to return_value or NULL if paramter does not exist
@@ -0,0 +1,137 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <axsdk/axevent.h>
+
+#include "event_extract.h"
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * One field to extract
+ */
+typedef struct {
+    gchar *key;
+    gchar *name_space;
+    ExtractType type;
+    gsize offset;
+    gsize size;
+    gboolean required;
+} ExtractField;
+
+/**
+ * Compiled list of event fields and where they go in a record struct
+ */
+struct EventExtractor {
+    GArray *fields;
+};
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Create an extractor without fields
+ */
+EventExtractor *event_extractor_new()
+{
+    EventExtractor *extractor = g_new0(EventExtractor, 1);
+
+    extractor->fields = g_array_new(FALSE, FALSE, sizeof(ExtractField));
+
+    return extractor;
+}
+
+/**
+ * Free an extractor
+ */
+void event_extractor_free(EventExtractor *extractor)
+{
+    guint i;
+
+    if (!extractor) {
+        return;
+    }
+
+    for (i = 0; i < extractor->fields->len; i++) {
+        ExtractField *field = &g_array_index(extractor->fields,
+            ExtractField, i);
+
+        g_free(field->key);
+        g_free(field->name_space);
+    }
+
+    g_array_free(extractor->fields, TRUE);
+    g_free(extractor);
+}
+
+/**
+ * Add a field to copy into the record at offset.
+ */
+void event_extractor_add(EventExtractor *extractor, const char *key,
+    const char *name_space, ExtractType type, gsize offset, gsize size,
+    gboolean required)
+{
+    ExtractField field = { 0 };
+
+    field.key = g_strdup(key);
+    field.name_space = g_strdup(name_space);
+    field.type = type;
+    field.offset = offset;
+    field.size = size;
+    field.required = required;
+
+    /* Required fields first, so a rejected event costs the least */
+    if (required) {
+        g_array_prepend_val(extractor->fields, field);
+    } else {
+        g_array_append_val(extractor->fields, field);
+    }
+}
+
+/**
+ * Copy all fields of an event into record in one pass over the compiled
+ * list.
+ */
+gboolean event_extractor_run(const EventExtractor *extractor,
+    const AXEventKeyValueSet *key_value_set, gpointer record)
+{
+    guint i;
+
+    for (i = 0; i < extractor->fields->len; i++) {
+        const ExtractField *field = &g_array_index(extractor->fields,
+            ExtractField, i);
+        gpointer target = (guint8 *) record + field->offset;
+        gchar *string = NULL;
+        gboolean found = FALSE;
+
+        switch (field->type) {
+        case EXTRACT_BOOL:
+            found = ax_event_key_value_set_get_boolean(key_value_set,
+                field->key, field->name_space, target, NULL);
+            break;
+        case EXTRACT_INT:
+            found = ax_event_key_value_set_get_integer(key_value_set,
+                field->key, field->name_space, target, NULL);
+            break;
+        case EXTRACT_STRING:
+            found = ax_event_key_value_set_get_string(key_value_set,
+                field->key, field->name_space, &string, NULL);
+
+            if (found) {
+                g_strlcpy(target, string, field->size);
+                g_free(string);
+            }
+            break;
+        }
+
+        if (!found && field->required) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
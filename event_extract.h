@@ -0,0 +1,45 @@
+#ifndef INCLUSION_GUARD_EVENT_EXTRACT_H
+#define INCLUSION_GUARD_EVENT_EXTRACT_H
+
+/**
+ * Value types an extractor can copy out of an event
+ */
+typedef enum {
+    EXTRACT_BOOL,
+    EXTRACT_INT,
+    EXTRACT_STRING
+} ExtractType;
+
+/**
+ * Compiled list of event fields and where they go in a record struct
+ */
+typedef struct EventExtractor EventExtractor;
+
+/**
+ * Create an extractor without fields
+ */
+EventExtractor *event_extractor_new();
+
+/**
+ * Free an extractor
+ */
+void event_extractor_free(EventExtractor *extractor);
+
+/**
+ * Add a field to copy into the record at offset. Booleans and integers
+ * are stored as gint, strings are truncated to size bytes including the
+ * terminator.
+ */
+void event_extractor_add(EventExtractor *extractor, const char *key,
+    const char *name_space, ExtractType type, gsize offset, gsize size,
+    gboolean required);
+
+/**
+ * Copy all fields of an event into record in one pass over the compiled
+ * list. Missing optional fields keep their value in record. Returns FALSE
+ * if a required field is missing.
+ */
+gboolean event_extractor_run(const EventExtractor *extractor,
+    const AXEventKeyValueSet *key_value_set, gpointer record);
+
+#endif // INCLUSION_GUARD_EVENT_EXTRACT_H
@@ -0,0 +1,499 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "event_log.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   { syslog(LOG_INFO, fmt, ## args); \
+    g_message(fmt, ## args); }
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
+    g_warning(fmt, ## args); }
+
+/**
+ * First bytes of a log, the last two are the format version
+ */
+#define LOG_MAGIC           "APDEVT01"
+
+/**
+ * Size of the file header
+ */
+#define LOG_HEADER_SIZE     8
+
+/**
+ * Entries are padded to this size, so each one can be read in place from a
+ * mapped log
+ */
+#define LOG_ALIGN           8
+
+/**
+ * Most events handed to the callback per main loop iteration, less than the
+ * event queue holds so a replay into it never overflows
+ */
+#define REPLAY_BATCH        32
+
+/**
+ * Entry flag for an event that event extraction rejected
+ */
+#define ENTRY_REJECTED      0x1
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Fixed part of a log entry in host byte order. The topic follows without
+ * terminator and the entry is zero padded to a multiple of LOG_ALIGN.
+ * flags holds ENTRY_ bits, logs from before it had the field read as 0.
+ */
+typedef struct {
+    guint32 length;
+    guint8 kind;
+    guint8 active;
+    guint16 topic_length;
+    guint32 index;
+    guint32 flags;
+    gint64 time;
+} EventLogEntry;
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Log being recorded to, NULL while not recording
+ */
+static FILE *record_file = NULL;
+
+/**
+ * Path of record_file
+ */
+static gchar *record_path = NULL;
+
+/**
+ * Number of events recorded since the log was opened
+ */
+static guint recorded = 0;
+
+/**
+ * Number of recorded events that extraction rejected
+ */
+static guint recorded_rejected = 0;
+
+/**
+ * Idle source flushing the events written since the last flush, 0 if none
+ */
+static guint flush_source = 0;
+
+/**
+ * Log being replayed, NULL while not replaying
+ */
+static GMappedFile *replay_file = NULL;
+
+/**
+ * Next entry to replay in replay_file
+ */
+static const gchar *replay_next = NULL;
+
+/**
+ * End of the last complete entry in replay_file
+ */
+static const gchar *replay_end = NULL;
+
+/**
+ * Replay speed factor, 0 for as fast as possible
+ */
+static gdouble replay_speed = 0;
+
+/**
+ * Recorded time of the first replayed event
+ */
+static gint64 replay_first = 0;
+
+/**
+ * Monotonic time the replay started
+ */
+static gint64 replay_start = 0;
+
+/**
+ * Source scheduling the next replay step, 0 if none
+ */
+static guint replay_source = 0;
+
+/**
+ * Callback replayed events are fed to
+ */
+static EventLogCallback replay_callback = NULL;
+
+/**
+ * User data for replay_callback
+ */
+static gpointer replay_user_data = NULL;
+
+/**
+ * Number of events replayed and in total in the current or last replay
+ */
+static guint replayed = 0;
+static guint replay_total = 0;
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Check the header and count the complete entries of a log. Returns FALSE
+ * if it is not a log, otherwise valid is set to the end of the last
+ * complete entry.
+ */
+static gboolean scan(const gchar *data, gsize size, gsize *valid,
+    guint *count);
+
+/**
+ * Flush the written events once the current burst is handled
+ */
+static gboolean flush_log(gpointer user_data);
+
+/**
+ * Stop a running replay
+ */
+static void replay_stop();
+
+/**
+ * Monotonic time of a recorded event on the replay timeline
+ */
+static gint64 replay_time(gint64 recorded);
+
+/**
+ * Feed the events that are due to the callback and schedule the next step
+ */
+static gboolean replay_step(gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Check the header and count the complete entries of a log.
+ */
+static gboolean scan(const gchar *data, gsize size, gsize *valid,
+    guint *count)
+{
+    gsize offset = LOG_HEADER_SIZE;
+
+    *valid = 0;
+    *count = 0;
+
+    if (size < LOG_HEADER_SIZE ||
+        memcmp(data, LOG_MAGIC, LOG_HEADER_SIZE) != 0) {
+        return FALSE;
+    }
+
+    while (size - offset >= sizeof(EventLogEntry)) {
+        const EventLogEntry *entry = (const EventLogEntry *) (data + offset);
+
+        if (entry->length < sizeof(EventLogEntry) + entry->topic_length ||
+            entry->length % LOG_ALIGN != 0 ||
+            entry->length > size - offset ||
+            entry->topic_length >= EVENT_TOPIC_SIZE) {
+            break;
+        }
+
+        offset += entry->length;
+        (*count)++;
+    }
+
+    *valid = offset;
+
+    return TRUE;
+}
+
+/**
+ * Flush the written events once the current burst is handled
+ */
+static gboolean flush_log(gpointer user_data)
+{
+    (void) user_data;
+
+    flush_source = 0;
+
+    if (record_file) {
+        fflush(record_file);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Stop a running replay
+ */
+static void replay_stop()
+{
+    if (replay_source) {
+        g_source_remove(replay_source);
+        replay_source = 0;
+    }
+
+    if (replay_file) {
+        g_mapped_file_unref(replay_file);
+        replay_file = NULL;
+    }
+}
+
+/**
+ * Monotonic time of a recorded event on the replay timeline
+ */
+static gint64 replay_time(gint64 recorded)
+{
+    /* As fast as possible keeps the recorded spacing for time windows */
+    if (replay_speed <= 0) {
+        return replay_start + (recorded - replay_first);
+    }
+
+    return replay_start + (gint64) ((recorded - replay_first) / replay_speed);
+}
+
+/**
+ * Feed the events that are due to the callback and schedule the next step
+ */
+static gboolean replay_step(gpointer user_data)
+{
+    gint64 now = g_get_monotonic_time();
+    guint n;
+
+    (void) user_data;
+
+    replay_source = 0;
+
+    for (n = 0; replay_next < replay_end && n < REPLAY_BATCH; n++) {
+        const EventLogEntry *entry = (const EventLogEntry *) replay_next;
+        EventRecord record = { 0 };
+
+        if (replay_speed > 0) {
+            gint64 due = replay_time(entry->time);
+
+            if (due > now) {
+                replay_source = g_timeout_add((due - now + 999) / 1000,
+                    replay_step, NULL);
+                return G_SOURCE_REMOVE;
+            }
+        }
+
+        record.kind = entry->kind;
+        record.index = entry->index;
+        record.active = entry->active;
+        record.time = replay_time(entry->time);
+        memcpy(record.topic, entry + 1, entry->topic_length);
+
+        replay_next += entry->length;
+        replayed++;
+
+        replay_callback(&record, (entry->flags & ENTRY_REJECTED) != 0,
+            replay_user_data);
+    }
+
+    /* Let the queued events drain before the next batch, and stop only once
+     * the last one has been drained so it is not recorded again */
+    if (n > 0) {
+        replay_source = g_idle_add(replay_step, NULL);
+    } else {
+        LOG("Replayed %u events", replayed);
+        replay_stop();
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Start appending events to the log at path, or stop recording if path is
+ * NULL or empty.
+ */
+gboolean event_log_open(const char *path)
+{
+    GMappedFile *mapped;
+    GError *error = NULL;
+    gsize valid = 0;
+    guint count = 0;
+
+    if (record_file) {
+        LOG("Stopped recording events to %s after %u events", record_path,
+            recorded);
+        fclose(record_file);
+        record_file = NULL;
+    }
+
+    if (flush_source) {
+        g_source_remove(flush_source);
+        flush_source = 0;
+    }
+
+    g_free(record_path);
+    record_path = NULL;
+    recorded = 0;
+    recorded_rejected = 0;
+
+    if (!path || *path == '\0') {
+        return TRUE;
+    }
+
+    /* Only append whole entries to a log of the same format */
+    mapped = g_mapped_file_new(path, FALSE, &error);
+
+    if (mapped) {
+        gsize size = g_mapped_file_get_length(mapped);
+
+        if (size > 0 && !scan(g_mapped_file_get_contents(mapped), size,
+            &valid, &count)) {
+            ERR("%s is not an event log, not recording", path);
+            g_mapped_file_unref(mapped);
+            return FALSE;
+        }
+
+        g_mapped_file_unref(mapped);
+
+        if (valid < size && truncate(path, valid) != 0) {
+            ERR("Could not drop the incomplete entry at the end of %s", path);
+            return FALSE;
+        }
+    } else {
+        g_clear_error(&error);
+    }
+
+    record_file = fopen(path, "ab");
+
+    if (!record_file) {
+        ERR("Could not open event log %s", path);
+        return FALSE;
+    }
+
+    if (valid == 0 && fwrite(LOG_MAGIC, LOG_HEADER_SIZE, 1, record_file) != 1) {
+        ERR("Could not write event log %s", path);
+        fclose(record_file);
+        record_file = NULL;
+        return FALSE;
+    }
+
+    fflush(record_file);
+    record_path = g_strdup(path);
+
+    LOG("Recording events to %s, %u events already in it", path, count);
+
+    return TRUE;
+}
+
+/**
+ * Append an incoming event to the log
+ */
+void event_log_write(const EventRecord *record, gboolean rejected)
+{
+    guint8 buffer[sizeof(EventLogEntry) + EVENT_TOPIC_SIZE + LOG_ALIGN];
+    EventLogEntry *entry = (EventLogEntry *) buffer;
+    gsize topic_length;
+    gsize length;
+
+    if (!record_file) {
+        return;
+    }
+
+    topic_length = strnlen(record->topic, EVENT_TOPIC_SIZE - 1);
+    length = sizeof(EventLogEntry) + topic_length;
+    length = (length + LOG_ALIGN - 1) & ~(gsize) (LOG_ALIGN - 1);
+    memset(buffer, 0, length);
+
+    entry->length = length;
+    entry->kind = record->kind;
+    entry->active = record->active ? 1 : 0;
+    entry->topic_length = topic_length;
+    entry->index = record->index;
+    entry->flags = rejected ? ENTRY_REJECTED : 0;
+    entry->time = record->time;
+    memcpy(entry + 1, record->topic, topic_length);
+
+    if (fwrite(buffer, length, 1, record_file) != 1) {
+        ERR("Could not write event log %s, stopped recording", record_path);
+        fclose(record_file);
+        record_file = NULL;
+        return;
+    }
+
+    recorded++;
+    recorded_rejected += rejected ? 1 : 0;
+
+    /* A burst reaches the file as a whole, a crash loses at most that */
+    if (!flush_source) {
+        flush_source = g_idle_add(flush_log, NULL);
+    }
+}
+
+/**
+ * Feed the log at path to callback.
+ */
+gboolean event_log_replay(const char *path, gdouble speed,
+    EventLogCallback callback, gpointer user_data)
+{
+    GError *error = NULL;
+    const gchar *data;
+    gsize valid;
+
+    replay_stop();
+
+    replay_file = g_mapped_file_new(path, FALSE, &error);
+
+    if (!replay_file) {
+        ERR("Could not open event log %s: %s", path, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    data = g_mapped_file_get_contents(replay_file);
+
+    if (!scan(data, g_mapped_file_get_length(replay_file), &valid,
+        &replay_total)) {
+        ERR("%s is not an event log", path);
+        replay_stop();
+        return FALSE;
+    }
+
+    replay_next = data + LOG_HEADER_SIZE;
+    replay_end = data + valid;
+    replay_speed = MAX(speed, 0);
+    replay_first = replay_total ?
+        ((const EventLogEntry *) replay_next)->time : 0;
+    replay_start = g_get_monotonic_time();
+    replay_callback = callback;
+    replay_user_data = user_data;
+    replayed = 0;
+
+    LOG("Replaying %u events from %s at speed %g", replay_total, path,
+        replay_speed);
+
+    replay_source = g_idle_add(replay_step, NULL);
+
+    return TRUE;
+}
+
+/**
+ * Write recorder and replay state as an XML element
+ */
+void event_log_report(GString *xml)
+{
+    g_string_append_printf(xml, "<eventlog recording='%d' recorded='%u' "
+        "rejected='%u' replaying='%d' replayed='%u' total='%u'/>",
+        record_file != NULL, recorded, recorded_rejected,
+        replay_file != NULL, replayed, replay_total);
+}
+
+/**
+ * Stop recording and replaying
+ */
+void event_log_cleanup()
+{
+    replay_stop();
+    event_log_open(NULL);
+}
@@ -0,0 +1,47 @@
+#ifndef INCLUSION_GUARD_EVENT_LOG_H
+#define INCLUSION_GUARD_EVENT_LOG_H
+
+#include "event_queue.h"
+
+/**
+ * Called from the main loop with each event read back from a log, rejected
+ * is TRUE for an event that event extraction rejected when it was recorded
+ */
+typedef void (*EventLogCallback)(const EventRecord *record,
+    gboolean rejected, gpointer user_data);
+
+/**
+ * Start appending events to the log at path, or stop recording if path is
+ * NULL or empty. An existing log is appended to if it has the right format.
+ */
+gboolean event_log_open(const char *path);
+
+/**
+ * Append an incoming event to the log as it arrives, before it is queued,
+ * with rejected set if event extraction rejected it. Does nothing while not
+ * recording. Live events are recorded while a replay runs, replayed ones
+ * are not written again.
+ */
+void event_log_write(const EventRecord *record, gboolean rejected);
+
+/**
+ * Feed the log at path to callback. With speed 1.0 events are spaced as
+ * recorded, higher values replay proportionally faster and 0 replays as
+ * fast as the main loop allows. A running replay is stopped first. Record
+ * times are moved to the replay, scaled by speed, and keep their recorded
+ * spacing with speed 0.
+ */
+gboolean event_log_replay(const char *path, gdouble speed,
+    EventLogCallback callback, gpointer user_data);
+
+/**
+ * Write recorder and replay state as an XML element
+ */
+void event_log_report(GString *xml);
+
+/**
+ * Stop recording and replaying
+ */
+void event_log_cleanup();
+
+#endif // INCLUSION_GUARD_EVENT_LOG_H
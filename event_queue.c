@@ -0,0 +1,184 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "event_queue.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
+    g_warning(fmt, ## args); }
+
+/**
+ * Ring capacity, a power of two so the free running indices wrap cleanly
+ */
+#define QUEUE_SIZE          256
+
+/**
+ * Most events handed to the handler per call
+ */
+#define BATCH_SIZE          32
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Preallocated ring of events
+ */
+static EventRecord ring[QUEUE_SIZE];
+
+/**
+ * Free running count of pushed events, only written by the producer
+ */
+static volatile gint head = 0;
+
+/**
+ * Free running count of drained events, only written by the consumer
+ */
+static volatile gint tail = 0;
+
+/**
+ * Non-zero while a drain is scheduled on the main loop
+ */
+static volatile gint scheduled = 0;
+
+/**
+ * Handler the ring is drained to
+ */
+static EventQueueHandler queue_handler = NULL;
+
+/**
+ * User data for queue_handler
+ */
+static gpointer queue_user_data = NULL;
+
+/**
+ * Number of events dropped because the ring was full
+ */
+static volatile gint dropped = 0;
+
+/**
+ * Highest number of events waiting at once
+ */
+static volatile gint high_water = 0;
+
+/**
+ * Number of handler calls
+ */
+static guint batches = 0;
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Idle callback handing all queued events to the handler in batches
+ */
+static gboolean drain(gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Idle callback handing all queued events to the handler in batches
+ */
+static gboolean drain(gpointer user_data)
+{
+    EventRecord batch[BATCH_SIZE];
+
+    (void) user_data;
+
+    /* Clear first, so an event pushed during the drain schedules another */
+    g_atomic_int_set(&scheduled, 0);
+
+    for (;;) {
+        guint t = (guint) tail;
+        guint n = MIN((guint) g_atomic_int_get(&head) - t, BATCH_SIZE);
+        guint i;
+
+        if (n == 0) {
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            batch[i] = ring[(t + i) % QUEUE_SIZE];
+        }
+
+        /* Hand the slots back before the handler runs */
+        g_atomic_int_set(&tail, t + n);
+
+        batches++;
+        queue_handler(batch, n, queue_user_data);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Set the handler that queued events are drained to
+ */
+void event_queue_init(EventQueueHandler handler, gpointer user_data)
+{
+    queue_handler = handler;
+    queue_user_data = user_data;
+}
+
+/**
+ * Queue an event from the event callback, the only producer.
+ */
+gboolean event_queue_push(const EventRecord *record)
+{
+    guint h = (guint) head;
+    guint depth = h - (guint) g_atomic_int_get(&tail);
+
+    if (depth >= QUEUE_SIZE) {
+        if (g_atomic_int_add(&dropped, 1) == 0) {
+            ERR("Event queue full, dropping events");
+        }
+
+        return FALSE;
+    }
+
+    ring[h % QUEUE_SIZE] = *record;
+
+    /* Publish the slot only once it is written */
+    g_atomic_int_set(&head, h + 1);
+
+    if ((gint) depth + 1 > g_atomic_int_get(&high_water)) {
+        g_atomic_int_set(&high_water, depth + 1);
+    }
+
+    if (queue_handler && g_atomic_int_compare_and_exchange(&scheduled, 0, 1)) {
+        g_idle_add(drain, ring);
+    }
+
+    return TRUE;
+}
+
+/**
+ * Write queue depth and counters as an XML element
+ */
+void event_queue_report(GString *xml)
+{
+    g_string_append_printf(xml, "<events depth='%u' capacity='%d' "
+        "high_water='%d' dropped='%d' batches='%u'/>",
+        (guint) g_atomic_int_get(&head) - (guint) g_atomic_int_get(&tail),
+        QUEUE_SIZE, g_atomic_int_get(&high_water),
+        g_atomic_int_get(&dropped), batches);
+}
+
+/**
+ * Stop draining, queued events are discarded
+ */
+void event_queue_cleanup()
+{
+    g_idle_remove_by_data(ring);
+
+    queue_handler = NULL;
+    g_atomic_int_set(&tail, g_atomic_int_get(&head));
+}
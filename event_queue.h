@@ -0,0 +1,57 @@
+#ifndef INCLUSION_GUARD_EVENT_QUEUE_H
+#define INCLUSION_GUARD_EVENT_QUEUE_H
+
+/**
+ * Kind of a queued event
+ */
+typedef enum {
+    EVENT_SCENARIO,
+    EVENT_PRESET
+} EventKind;
+
+/**
+ * Longest scenario name kept in a queued event, including the terminator
+ */
+#define EVENT_TOPIC_SIZE 64
+
+/**
+ * Fields copied out of an axevent, index is the preset number for
+ * EVENT_PRESET and topic the scenario name for EVENT_SCENARIO
+ */
+typedef struct {
+    EventKind kind;
+    guint subscription;
+    guint index;
+    gboolean active;
+    gint64 time;
+    gchar topic[EVENT_TOPIC_SIZE];
+} EventRecord;
+
+/**
+ * Called from the main loop with a batch of queued events in arrival order
+ */
+typedef void (*EventQueueHandler)(const EventRecord *records, guint count,
+    gpointer user_data);
+
+/**
+ * Set the handler that queued events are drained to
+ */
+void event_queue_init(EventQueueHandler handler, gpointer user_data);
+
+/**
+ * Queue an event from the event callback, the only producer. Never blocks,
+ * returns FALSE and counts the event as dropped if the queue is full.
+ */
+gboolean event_queue_push(const EventRecord *record);
+
+/**
+ * Write queue depth and counters as an XML element
+ */
+void event_queue_report(GString *xml);
+
+/**
+ * Stop draining, queued events are discarded
+ */
+void event_queue_cleanup();
+
+#endif // INCLUSION_GUARD_EVENT_QUEUE_H
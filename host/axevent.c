@@ -0,0 +1,926 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <axsdk/axevent.h>
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   g_message("axevent: " fmt, ## args)
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   g_warning("axevent: " fmt, ## args)
+
+/**
+ * Most script steps run back to back before the main loop gets a turn
+ */
+#define SCRIPT_BURST        256
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * One key of a set, values are kept as text and NULL matches any value
+ */
+typedef struct {
+    gchar *key;
+    gchar *name_space;
+    AXEventValueType type;
+    gchar *value;
+} KeyValue;
+
+/**
+ * Keys with optional namespace, value and type
+ */
+struct _AXEventKeyValueSet {
+    GPtrArray *entries;
+};
+
+/**
+ * Event with its key-value set and time stamp
+ */
+struct _AXEvent {
+    AXEventKeyValueSet *key_value_set;
+    GTimeVal time_stamp;
+};
+
+/**
+ * What a script line does
+ */
+typedef enum {
+    STEP_EVENT,
+    STEP_LOOP,
+    STEP_QUIT
+} StepKind;
+
+/**
+ * One parsed script line, count is the number of repeats for STEP_LOOP
+ */
+typedef struct {
+    guint delay;
+    StepKind kind;
+    guint count;
+    AXEventKeyValueSet *key_value_set;
+} ScriptStep;
+
+/**
+ * Subscription with the keys an event must have
+ */
+typedef struct {
+    guint id;
+    AXEventKeyValueSet *key_value_set;
+    AXSubscriptionCallback callback;
+    gpointer user_data;
+} Subscription;
+
+/**
+ * Connection to the event system
+ */
+struct _AXEventHandler {
+    GPtrArray *subscriptions;
+    GHashTable *declarations;
+    guint next_id;
+};
+
+/**
+ * Script shared by all handlers, like events on the device reach every
+ * connection to the event system
+ */
+typedef struct {
+    GArray *steps;
+    guint step;
+    guint loops;
+    guint source;
+    guint64 scripted;
+    guint64 delivered;
+    guint64 sent;
+} Script;
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Handlers of the application, the script runs while there are any
+ */
+static GList *handlers;
+
+/**
+ * Event script and its counters
+ */
+static Script script;
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Free a key and its value
+ */
+static void key_value_free(gpointer data);
+
+/**
+ * Find a key, NULL if the set does not have it
+ */
+static const KeyValue *find(const AXEventKeyValueSet *key_value_set,
+    const gchar *key, const gchar *name_space);
+
+/**
+ * Copy a key-value set
+ */
+static AXEventKeyValueSet *copy_set(const AXEventKeyValueSet *key_value_set);
+
+/**
+ * Parse a boolean value as written by the application or a script
+ */
+static gboolean parse_boolean(const gchar *value, gboolean *result);
+
+/**
+ * TRUE if value matches the value of a subscription key
+ */
+static gboolean value_matches(const KeyValue *pattern, const gchar *value);
+
+/**
+ * TRUE if the event has all keys of the subscription with matching values
+ */
+static gboolean matches(const AXEventKeyValueSet *pattern,
+    const AXEventKeyValueSet *key_value_set);
+
+/**
+ * Hand an event to every subscription it matches
+ */
+static void deliver(const AXEventKeyValueSet *key_value_set);
+
+/**
+ * Parse one script line, FALSE if it is invalid
+ */
+static gboolean parse_step(const gchar *line, ScriptStep *step);
+
+/**
+ * Load the script named by AXEVENT_SCRIPT
+ */
+static void load_script(void);
+
+/**
+ * Stop the script and free its steps
+ */
+static void free_script(void);
+
+/**
+ * Log the script counters
+ */
+static void report(void);
+
+/**
+ * Timer callback running the script steps that are due
+ */
+static gboolean run_script(gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Free a key and its value
+ */
+static void key_value_free(gpointer data)
+{
+    KeyValue *entry = data;
+
+    g_free(entry->key);
+    g_free(entry->name_space);
+    g_free(entry->value);
+    g_free(entry);
+}
+
+/**
+ * Find a key, NULL if the set does not have it
+ */
+static const KeyValue *find(const AXEventKeyValueSet *key_value_set,
+    const gchar *key, const gchar *name_space)
+{
+    guint i;
+
+    for (i = 0; i < key_value_set->entries->len; i++) {
+        const KeyValue *entry = g_ptr_array_index(key_value_set->entries, i);
+
+        if (g_strcmp0(entry->key, key) == 0 &&
+            g_strcmp0(entry->name_space, name_space) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Copy a key-value set
+ */
+static AXEventKeyValueSet *copy_set(const AXEventKeyValueSet *key_value_set)
+{
+    AXEventKeyValueSet *copy = ax_event_key_value_set_new();
+    guint i;
+
+    for (i = 0; i < key_value_set->entries->len; i++) {
+        const KeyValue *entry = g_ptr_array_index(key_value_set->entries, i);
+        KeyValue *dup = g_new0(KeyValue, 1);
+
+        dup->key = g_strdup(entry->key);
+        dup->name_space = g_strdup(entry->name_space);
+        dup->type = entry->type;
+        dup->value = g_strdup(entry->value);
+
+        g_ptr_array_add(copy->entries, dup);
+    }
+
+    return copy;
+}
+
+/**
+ * Parse a boolean value as written by the application or a script
+ */
+static gboolean parse_boolean(const gchar *value, gboolean *result)
+{
+    if (g_strcmp0(value, "1") == 0 || g_strcmp0(value, "true") == 0) {
+        *result = TRUE;
+    } else if (g_strcmp0(value, "0") == 0 || g_strcmp0(value, "false") == 0) {
+        *result = FALSE;
+    } else {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * TRUE if value matches the value of a subscription key
+ */
+static gboolean value_matches(const KeyValue *pattern, const gchar *value)
+{
+    gboolean a;
+    gboolean b;
+
+    if (!pattern->value) {
+        return TRUE;
+    }
+
+    if (!value) {
+        return FALSE;
+    }
+
+    switch (pattern->type) {
+    case AX_VALUE_TYPE_BOOL:
+        return parse_boolean(pattern->value, &a) &&
+            parse_boolean(value, &b) && a == b;
+    case AX_VALUE_TYPE_INT:
+        return g_ascii_strtoll(pattern->value, NULL, 10) ==
+            g_ascii_strtoll(value, NULL, 10);
+    default:
+        return strcmp(pattern->value, value) == 0;
+    }
+}
+
+/**
+ * TRUE if the event has all keys of the subscription with matching values
+ */
+static gboolean matches(const AXEventKeyValueSet *pattern,
+    const AXEventKeyValueSet *key_value_set)
+{
+    guint i;
+
+    for (i = 0; i < pattern->entries->len; i++) {
+        const KeyValue *entry = g_ptr_array_index(pattern->entries, i);
+        const KeyValue *found = find(key_value_set, entry->key,
+            entry->name_space);
+
+        if (!found || !value_matches(entry, found->value)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Hand an event to every subscription it matches
+ */
+static void deliver(const AXEventKeyValueSet *key_value_set)
+{
+    GList *item;
+    guint i;
+
+    script.scripted++;
+
+    for (item = handlers; item; item = item->next) {
+        AXEventHandler *event_handler = item->data;
+
+        for (i = 0; i < event_handler->subscriptions->len; i++) {
+            Subscription *subscription =
+                g_ptr_array_index(event_handler->subscriptions, i);
+            AXEvent *event;
+
+            if (!matches(subscription->key_value_set, key_value_set)) {
+                continue;
+            }
+
+            /* The application does not take ownership of delivered events */
+            event = ax_event_new((AXEventKeyValueSet *) key_value_set, NULL);
+            subscription->callback(subscription->id, event,
+                subscription->user_data);
+            ax_event_free(event);
+
+            script.delivered++;
+        }
+    }
+}
+
+/**
+ * Parse one script line, FALSE if it is invalid
+ */
+static gboolean parse_step(const gchar *line, ScriptStep *step)
+{
+    gchar **words = g_strsplit_set(line, " \t", -1);
+    gboolean ok = TRUE;
+    gchar *end;
+    guint i;
+
+    memset(step, 0, sizeof(*step));
+
+    step->delay = strtoul(words[0], &end, 10);
+
+    if (end == words[0] || *end != '\0') {
+        g_strfreev(words);
+        return FALSE;
+    }
+
+    step->kind = STEP_EVENT;
+
+    for (i = 1; ok && words[i]; i++) {
+        gchar *word = words[i];
+        gchar *value;
+        gchar *key;
+        KeyValue *entry;
+
+        if (*word == '\0') {
+            continue;
+        }
+
+        if (i == 1 && strcmp(word, "quit") == 0) {
+            step->kind = STEP_QUIT;
+            continue;
+        }
+
+        if (i == 1 && strcmp(word, "loop") == 0) {
+            step->kind = STEP_LOOP;
+            ok = words[2] != NULL;
+
+            if (ok) {
+                step->count = strtoul(words[2], NULL, 10);
+            }
+
+            break;
+        }
+
+        value = strchr(word, '=');
+        ok = value != NULL;
+
+        if (!ok) {
+            break;
+        }
+
+        *value++ = '\0';
+        key = strchr(word, ':');
+
+        if (!step->key_value_set) {
+            step->key_value_set = ax_event_key_value_set_new();
+        }
+
+        entry = g_new0(KeyValue, 1);
+        entry->key = g_strdup(key ? key + 1 : word);
+        entry->name_space = key ? g_strndup(word, key - word) : NULL;
+        entry->type = AX_VALUE_TYPE_STRING;
+        entry->value = g_strdup(value);
+
+        g_ptr_array_add(step->key_value_set->entries, entry);
+    }
+
+    g_strfreev(words);
+
+    if (!ok || (step->kind == STEP_EVENT && !step->key_value_set)) {
+        if (step->key_value_set) {
+            ax_event_key_value_set_free(step->key_value_set);
+        }
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Load the script named by AXEVENT_SCRIPT
+ */
+static void load_script(void)
+{
+    const gchar *path = g_getenv("AXEVENT_SCRIPT");
+    GError *error = NULL;
+    gchar *contents;
+    gchar **lines;
+    guint i;
+
+    if (!path) {
+        return;
+    }
+
+    if (!g_file_get_contents(path, &contents, NULL, &error)) {
+        ERR("Could not read event script: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+
+    for (i = 0; lines[i]; i++) {
+        gchar *line = g_strstrip(lines[i]);
+        ScriptStep step;
+
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+
+        if (!parse_step(line, &step)) {
+            ERR("%s:%u: expected <delay ms> followed by [ns:]key=value "
+                "pairs, 'loop <count>' or 'quit'", path, i + 1);
+            continue;
+        }
+
+        g_array_append_val(script.steps, step);
+    }
+
+    g_strfreev(lines);
+
+    LOG("Loaded %u steps from %s", script.steps->len, path);
+}
+
+/**
+ * Stop the script and free its steps
+ */
+static void free_script(void)
+{
+    guint i;
+
+    if (script.source) {
+        g_source_remove(script.source);
+    }
+
+    for (i = 0; i < script.steps->len; i++) {
+        ScriptStep *step = &g_array_index(script.steps, ScriptStep, i);
+
+        if (step->key_value_set) {
+            ax_event_key_value_set_free(step->key_value_set);
+        }
+    }
+
+    g_array_free(script.steps, TRUE);
+    memset(&script, 0, sizeof(script));
+}
+
+/**
+ * Log the script counters
+ */
+static void report(void)
+{
+    LOG("Script done, %" G_GUINT64_FORMAT " events, %" G_GUINT64_FORMAT
+        " deliveries, %" G_GUINT64_FORMAT " events sent",
+        script.scripted, script.delivered, script.sent);
+}
+
+/**
+ * Timer callback running the script steps that are due
+ */
+static gboolean run_script(gpointer user_data)
+{
+    guint n;
+
+    (void) user_data;
+
+    script.source = 0;
+
+    for (n = 0; n < SCRIPT_BURST; n++) {
+        ScriptStep *step = &g_array_index(script.steps, ScriptStep,
+            script.step);
+
+        switch (step->kind) {
+        case STEP_EVENT:
+            deliver(step->key_value_set);
+            script.step++;
+            break;
+        case STEP_LOOP:
+            /* A count of 0 repeats forever */
+            if (step->count == 0 || ++script.loops < step->count) {
+                script.step = 0;
+            } else {
+                script.loops = 0;
+                script.step++;
+            }
+            break;
+        case STEP_QUIT:
+            report();
+            raise(SIGTERM);
+            return G_SOURCE_REMOVE;
+        }
+
+        if (script.step >= script.steps->len) {
+            report();
+            return G_SOURCE_REMOVE;
+        }
+
+        step = &g_array_index(script.steps, ScriptStep, script.step);
+
+        if (step->delay > 0) {
+            script.source = g_timeout_add(step->delay, run_script, NULL);
+            return G_SOURCE_REMOVE;
+        }
+    }
+
+    /* Let the application drain before the rest of the burst */
+    script.source = g_timeout_add(0, run_script, NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+AXEventHandler *ax_event_handler_new(void)
+{
+    AXEventHandler *event_handler = g_new0(AXEventHandler, 1);
+
+    event_handler->subscriptions = g_ptr_array_new();
+    event_handler->declarations = g_hash_table_new_full(g_direct_hash,
+        g_direct_equal, NULL, (GDestroyNotify) ax_event_key_value_set_free);
+    event_handler->next_id = 1;
+
+    /* The first handler starts the script once the main loop runs */
+    if (!handlers) {
+        script.steps = g_array_new(FALSE, FALSE, sizeof(ScriptStep));
+        load_script();
+
+        if (script.steps->len > 0) {
+            script.source = g_timeout_add(
+                g_array_index(script.steps, ScriptStep, 0).delay,
+                run_script, NULL);
+        }
+    }
+
+    handlers = g_list_append(handlers, event_handler);
+
+    return event_handler;
+}
+
+void ax_event_handler_free(AXEventHandler *event_handler)
+{
+    guint i;
+
+    if (!event_handler) {
+        return;
+    }
+
+    handlers = g_list_remove(handlers, event_handler);
+
+    if (!handlers) {
+        free_script();
+    }
+
+    for (i = 0; i < event_handler->subscriptions->len; i++) {
+        Subscription *subscription =
+            g_ptr_array_index(event_handler->subscriptions, i);
+
+        ax_event_key_value_set_free(subscription->key_value_set);
+        g_free(subscription);
+    }
+
+    g_ptr_array_free(event_handler->subscriptions, TRUE);
+    g_hash_table_destroy(event_handler->declarations);
+    g_free(event_handler);
+}
+
+gboolean ax_event_handler_subscribe(AXEventHandler *event_handler,
+    AXEventKeyValueSet *key_value_set, guint *subscription,
+    AXSubscriptionCallback callback, gpointer user_data, GError **error)
+{
+    Subscription *entry = g_new0(Subscription, 1);
+
+    (void) error;
+
+    entry->id = event_handler->next_id++;
+    entry->key_value_set = copy_set(key_value_set);
+    entry->callback = callback;
+    entry->user_data = user_data;
+
+    g_ptr_array_add(event_handler->subscriptions, entry);
+    *subscription = entry->id;
+
+    return TRUE;
+}
+
+gboolean ax_event_handler_unsubscribe(AXEventHandler *event_handler,
+    guint subscription, GError **error)
+{
+    guint i;
+
+    (void) error;
+
+    for (i = 0; i < event_handler->subscriptions->len; i++) {
+        Subscription *entry =
+            g_ptr_array_index(event_handler->subscriptions, i);
+
+        if (entry->id == subscription) {
+            ax_event_key_value_set_free(entry->key_value_set);
+            g_free(entry);
+            g_ptr_array_remove_index(event_handler->subscriptions, i);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+gboolean ax_event_handler_declare(AXEventHandler *event_handler,
+    AXEventKeyValueSet *key_value_set, gboolean stateless,
+    guint *declaration, AXDeclarationCompleteCallback callback,
+    gpointer user_data, GError **error)
+{
+    (void) stateless;
+    (void) callback;
+    (void) user_data;
+    (void) error;
+
+    *declaration = event_handler->next_id++;
+    g_hash_table_insert(event_handler->declarations,
+        GUINT_TO_POINTER(*declaration), copy_set(key_value_set));
+
+    return TRUE;
+}
+
+gboolean ax_event_handler_undeclare(AXEventHandler *event_handler,
+    guint declaration, GError **error)
+{
+    (void) error;
+
+    return g_hash_table_remove(event_handler->declarations,
+        GUINT_TO_POINTER(declaration));
+}
+
+gboolean ax_event_handler_send_event(AXEventHandler *event_handler,
+    guint declaration, AXEvent *event, GError **error)
+{
+    GString *text;
+    guint i;
+
+    (void) error;
+
+    if (!g_hash_table_contains(event_handler->declarations,
+        GUINT_TO_POINTER(declaration))) {
+        return FALSE;
+    }
+
+    script.sent++;
+
+    text = g_string_new(NULL);
+
+    for (i = 0; i < event->key_value_set->entries->len; i++) {
+        const KeyValue *entry =
+            g_ptr_array_index(event->key_value_set->entries, i);
+
+        g_string_append_printf(text, " %s%s%s=%s",
+            entry->name_space ? entry->name_space : "",
+            entry->name_space ? ":" : "", entry->key, entry->value);
+    }
+
+    g_debug("axevent: declaration %u sent%s", declaration, text->str);
+    g_string_free(text, TRUE);
+
+    return TRUE;
+}
+
+AXEventKeyValueSet *ax_event_key_value_set_new(void)
+{
+    AXEventKeyValueSet *key_value_set = g_new0(AXEventKeyValueSet, 1);
+
+    key_value_set->entries = g_ptr_array_new_with_free_func(key_value_free);
+
+    return key_value_set;
+}
+
+void ax_event_key_value_set_free(AXEventKeyValueSet *key_value_set)
+{
+    if (!key_value_set) {
+        return;
+    }
+
+    g_ptr_array_free(key_value_set->entries, TRUE);
+    g_free(key_value_set);
+}
+
+gboolean ax_event_key_value_set_add_key_value(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, gconstpointer value, AXEventValueType value_type,
+    GError **error)
+{
+    KeyValue *entry = (KeyValue *) find(key_value_set, key, name_space);
+
+    (void) error;
+
+    /* Adding a key again replaces its value */
+    if (!entry) {
+        entry = g_new0(KeyValue, 1);
+        entry->key = g_strdup(key);
+        entry->name_space = g_strdup(name_space);
+        g_ptr_array_add(key_value_set->entries, entry);
+    }
+
+    g_free(entry->value);
+    entry->value = NULL;
+    entry->type = value_type;
+
+    if (!value) {
+        return TRUE;
+    }
+
+    switch (value_type) {
+    case AX_VALUE_TYPE_INT:
+        entry->value = g_strdup_printf("%d", *(const gint *) value);
+        break;
+    case AX_VALUE_TYPE_BOOL:
+        entry->value = g_strdup(*(const gboolean *) value ? "1" : "0");
+        break;
+    case AX_VALUE_TYPE_DOUBLE:
+        entry->value = g_strdup_printf("%g", *(const gdouble *) value);
+        break;
+    default:
+        entry->value = g_strdup(value);
+        break;
+    }
+
+    return TRUE;
+}
+
+gboolean ax_event_key_value_set_add_key_values(
+    AXEventKeyValueSet *key_value_set, GError **error, ...)
+{
+    const gchar *key;
+    va_list args;
+
+    va_start(args, error);
+
+    while ((key = va_arg(args, const gchar *))) {
+        const gchar *name_space = va_arg(args, const gchar *);
+        gconstpointer value = va_arg(args, gconstpointer);
+        AXEventValueType value_type = va_arg(args, AXEventValueType);
+
+        ax_event_key_value_set_add_key_value(key_value_set, key, name_space,
+            value, value_type, error);
+    }
+
+    va_end(args);
+
+    return TRUE;
+}
+
+gboolean ax_event_key_value_set_remove_key(AXEventKeyValueSet *key_value_set,
+    const gchar *key, const gchar *name_space, GError **error)
+{
+    const KeyValue *entry = find(key_value_set, key, name_space);
+
+    (void) error;
+
+    return entry && g_ptr_array_remove(key_value_set->entries,
+        (gpointer) entry);
+}
+
+gboolean ax_event_key_value_set_get_boolean(
+    const AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, gboolean *value, GError **error)
+{
+    const KeyValue *entry = find(key_value_set, key, name_space);
+
+    (void) error;
+
+    return entry && parse_boolean(entry->value, value);
+}
+
+gboolean ax_event_key_value_set_get_integer(
+    const AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, gint *value, GError **error)
+{
+    const KeyValue *entry = find(key_value_set, key, name_space);
+    gchar *end;
+    gint64 number;
+
+    (void) error;
+
+    if (!entry || !entry->value) {
+        return FALSE;
+    }
+
+    number = g_ascii_strtoll(entry->value, &end, 10);
+
+    if (end == entry->value || *end != '\0') {
+        return FALSE;
+    }
+
+    *value = number;
+
+    return TRUE;
+}
+
+gboolean ax_event_key_value_set_get_string(
+    const AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, gchar **value, GError **error)
+{
+    const KeyValue *entry = find(key_value_set, key, name_space);
+
+    (void) error;
+
+    if (!entry || !entry->value) {
+        return FALSE;
+    }
+
+    *value = g_strdup(entry->value);
+
+    return TRUE;
+}
+
+gboolean ax_event_key_value_set_mark_as_source(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, GError **error)
+{
+    (void) error;
+
+    return find(key_value_set, key, name_space) != NULL;
+}
+
+gboolean ax_event_key_value_set_mark_as_data(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, GError **error)
+{
+    (void) error;
+
+    return find(key_value_set, key, name_space) != NULL;
+}
+
+gboolean ax_event_key_value_set_mark_as_user_defined(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, const gchar *user_tag, GError **error)
+{
+    (void) user_tag;
+    (void) error;
+
+    return find(key_value_set, key, name_space) != NULL;
+}
+
+gboolean ax_event_key_value_set_add_nice_names(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, const gchar *key_nice_name,
+    const gchar *value_nice_name, GError **error)
+{
+    (void) key_nice_name;
+    (void) value_nice_name;
+    (void) error;
+
+    return find(key_value_set, key, name_space) != NULL;
+}
+
+AXEvent *ax_event_new(AXEventKeyValueSet *key_value_set,
+    GTimeVal *time_stamp)
+{
+    AXEvent *event = g_new0(AXEvent, 1);
+
+    event->key_value_set = copy_set(key_value_set);
+
+    if (time_stamp) {
+        event->time_stamp = *time_stamp;
+    } else {
+        g_get_current_time(&event->time_stamp);
+    }
+
+    return event;
+}
+
+void ax_event_free(AXEvent *event)
+{
+    if (!event) {
+        return;
+    }
+
+    ax_event_key_value_set_free(event->key_value_set);
+    g_free(event);
+}
+
+const AXEventKeyValueSet *ax_event_get_key_value_set(AXEvent *event)
+{
+    return event->key_value_set;
+}
@@ -0,0 +1,237 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <gio/gio.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <axsdk/axhttp.h>
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   g_message("axhttp: " fmt, ## args)
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   g_warning("axhttp: " fmt, ## args)
+
+/**
+ * Port served when AXHTTP_PORT is not set
+ */
+#define HTTP_PORT           8080
+
+/**
+ * Timeout in seconds for reading a request
+ */
+#define HTTP_TIMEOUT        5
+
+/**
+ * Largest request body read into the parameters
+ */
+#define HTTP_MAX_BODY       65536
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Handler receiving the application's CGI requests
+ */
+struct _AXHttpHandler {
+    GSocketService *service;
+    AXHttpRequestCallback callback;
+    gpointer user_data;
+};
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Read a request and let the callback answer it. Requests are handled one
+ * at a time on the main loop, like the application gets them on the device.
+ */
+static gboolean incoming(GSocketService *service,
+    GSocketConnection *connection, GObject *source_object,
+    gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Read a request and let the callback answer it.
+ */
+static gboolean incoming(GSocketService *service,
+    GSocketConnection *connection, GObject *source_object,
+    gpointer user_data)
+{
+    AXHttpHandler *handler = user_data;
+    GOutputStream *output = g_io_stream_get_output_stream(
+        G_IO_STREAM(connection));
+    GDataInputStream *input = g_data_input_stream_new(
+        g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+    GOutputStream *reply = g_memory_output_stream_new_resizable();
+    GHashTable *params = NULL;
+    gsize content_length = 0;
+    gchar **request = NULL;
+    gchar *query = NULL;
+    gchar *line;
+    GBytes *bytes;
+    gsize size;
+    const gchar *data;
+
+    (void) service;
+    (void) source_object;
+
+    g_socket_set_timeout(g_socket_connection_get_socket(connection),
+        HTTP_TIMEOUT);
+    g_filter_input_stream_set_close_base_stream(G_FILTER_INPUT_STREAM(input),
+        FALSE);
+    g_data_input_stream_set_newline_type(input,
+        G_DATA_STREAM_NEWLINE_TYPE_ANY);
+
+    /* "<method> <target> HTTP/1.x" */
+    line = g_data_input_stream_read_line(input, NULL, NULL, NULL);
+    request = line ? g_strsplit(line, " ", 3) : NULL;
+    g_free(line);
+
+    if (!request || g_strv_length(request) != 3) {
+        goto done;
+    }
+
+    while ((line = g_data_input_stream_read_line(input, NULL, NULL, NULL))) {
+        gboolean end = *line == '\0';
+
+        if (g_ascii_strncasecmp(line, "Content-Length:", 15) == 0) {
+            content_length = g_ascii_strtoull(line + 15, NULL, 10);
+        }
+
+        g_free(line);
+
+        if (end) {
+            break;
+        }
+    }
+
+    query = strchr(request[1], '?');
+
+    if (query) {
+        *query++ = '\0';
+    }
+
+    params = g_uri_parse_params(query ? query : "", -1, "&",
+        G_URI_PARAMS_WWW_FORM, NULL);
+
+    /* Form posts add their fields to the query parameters */
+    if (content_length > 0 && content_length <= HTTP_MAX_BODY) {
+        gchar *body = g_malloc0(content_length + 1);
+        GHashTable *fields;
+
+        if (g_input_stream_read_all(G_INPUT_STREAM(input), body,
+            content_length, NULL, NULL, NULL)) {
+            fields = g_uri_parse_params(body, -1, "&",
+                G_URI_PARAMS_WWW_FORM, NULL);
+
+            if (fields && params) {
+                GHashTableIter iter;
+                gpointer key;
+                gpointer value;
+
+                g_hash_table_iter_init(&iter, fields);
+
+                while (g_hash_table_iter_next(&iter, &key, &value)) {
+                    g_hash_table_iter_steal(&iter);
+                    g_hash_table_replace(params, key, value);
+                }
+            }
+
+            if (fields) {
+                g_hash_table_unref(fields);
+            }
+        }
+
+        g_free(body);
+    }
+
+    if (!params) {
+        params = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+
+    handler->callback(request[1], request[0], query, params, reply,
+        handler->user_data);
+
+    g_hash_table_unref(params);
+
+done:
+    g_output_stream_close(reply, NULL, NULL);
+    bytes = g_memory_output_stream_steal_as_bytes(
+        G_MEMORY_OUTPUT_STREAM(reply));
+    data = g_bytes_get_data(bytes, &size);
+
+    /* The application writes its own status line for errors only */
+    if (request && (size < 5 || strncmp(data, "HTTP/", 5) != 0)) {
+        g_output_stream_write_all(output, "HTTP/1.0 200 OK\r\n", 17, NULL,
+            NULL, NULL);
+    } else if (!request) {
+        g_output_stream_write_all(output, "HTTP/1.0 400 Bad Request\r\n\r\n",
+            28, NULL, NULL, NULL);
+    }
+
+    g_output_stream_write_all(output, data, size, NULL, NULL, NULL);
+    g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+
+    g_bytes_unref(bytes);
+    g_object_unref(reply);
+    g_object_unref(input);
+    g_strfreev(request);
+
+    return TRUE;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+AXHttpHandler *ax_http_handler_new(AXHttpRequestCallback callback,
+    gpointer user_data)
+{
+    AXHttpHandler *handler = g_new0(AXHttpHandler, 1);
+    const gchar *port = g_getenv("AXHTTP_PORT");
+    GInetAddress *loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    GSocketAddress *address = g_inet_socket_address_new(loopback,
+        port ? strtoul(port, NULL, 10) : HTTP_PORT);
+    GError *error = NULL;
+
+    handler->callback = callback;
+    handler->user_data = user_data;
+    handler->service = g_socket_service_new();
+
+    if (g_socket_listener_add_address(G_SOCKET_LISTENER(handler->service),
+        address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL, NULL,
+        &error)) {
+        LOG("Serving CGIs on http://127.0.0.1:%u",
+            g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(address)));
+    } else {
+        ERR("Could not serve CGIs: %s", error->message);
+        g_error_free(error);
+    }
+
+    g_signal_connect(handler->service, "incoming", G_CALLBACK(incoming),
+        handler);
+    g_socket_service_start(handler->service);
+
+    g_object_unref(address);
+    g_object_unref(loopback);
+
+    return handler;
+}
+
+void ax_http_handler_free(AXHttpHandler *handler)
+{
+    if (!handler) {
+        return;
+    }
+
+    g_socket_service_stop(handler->service);
+    g_socket_listener_close(G_SOCKET_LISTENER(handler->service));
+    g_object_unref(handler->service);
+    g_free(handler);
+}
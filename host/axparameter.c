@@ -0,0 +1,224 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <axsdk/axparameter.h>
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   g_message("axparameter: " fmt, ## args)
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   g_warning("axparameter: " fmt, ## args)
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Callback registered for one parameter
+ */
+typedef struct {
+    AXParameterCallback callback;
+    gpointer user_data;
+} ParameterCallback;
+
+/**
+ * Parameters of one application
+ */
+struct _AXParameter {
+    gchar *app_name;
+    GHashTable *values;
+    GHashTable *callbacks;
+    GQueue changed;
+    guint source;
+};
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Load the Name="value" lines of a param.conf file
+ */
+static void load_values(AXParameter *parameter, const gchar *path);
+
+/**
+ * Idle callback reporting changed parameters to their callbacks
+ */
+static gboolean notify(gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Load the Name="value" lines of a param.conf file
+ */
+static void load_values(AXParameter *parameter, const gchar *path)
+{
+    GError *error = NULL;
+    gchar *contents;
+    gchar **lines;
+    guint i;
+
+    if (!g_file_get_contents(path, &contents, NULL, &error)) {
+        ERR("Could not read parameters: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+
+    for (i = 0; lines[i]; i++) {
+        gchar *name = g_strstrip(lines[i]);
+        gchar *value = strstr(name, "=\"");
+        gchar *end;
+
+        if (!value) {
+            continue;
+        }
+
+        *value = '\0';
+        value += 2;
+        end = strchr(value, '"');
+
+        if (!end) {
+            ERR("%s:%u: unterminated value", path, i + 1);
+            continue;
+        }
+
+        *end = '\0';
+        g_hash_table_insert(parameter->values, g_strdup(name),
+            g_strdup(value));
+    }
+
+    g_strfreev(lines);
+
+    LOG("Loaded %u parameters from %s", g_hash_table_size(parameter->values),
+        path);
+}
+
+/**
+ * Idle callback reporting changed parameters to their callbacks
+ */
+static gboolean notify(gpointer user_data)
+{
+    AXParameter *parameter = user_data;
+    gchar *name;
+
+    parameter->source = 0;
+
+    while ((name = g_queue_pop_head(&parameter->changed))) {
+        ParameterCallback *entry = g_hash_table_lookup(parameter->callbacks,
+            name);
+        const gchar *value = g_hash_table_lookup(parameter->values, name);
+
+        if (entry && value) {
+            gchar *full_name = g_strdup_printf("root.%s.%s",
+                parameter->app_name, name);
+
+            entry->callback(full_name, value, entry->user_data);
+            g_free(full_name);
+        }
+
+        g_free(name);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+AXParameter *ax_parameter_new(const gchar *app_name, GError **error)
+{
+    AXParameter *parameter = g_new0(AXParameter, 1);
+    const gchar *path = g_getenv("AXPARAMETER_FILE");
+
+    (void) error;
+
+    parameter->app_name = g_strdup(app_name);
+    parameter->values = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, g_free);
+    parameter->callbacks = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, g_free);
+    g_queue_init(&parameter->changed);
+
+    load_values(parameter, path ? path : "param.conf");
+
+    return parameter;
+}
+
+void ax_parameter_free(AXParameter *parameter)
+{
+    if (!parameter) {
+        return;
+    }
+
+    if (parameter->source) {
+        g_source_remove(parameter->source);
+    }
+
+    g_queue_clear_full(&parameter->changed, g_free);
+    g_hash_table_destroy(parameter->values);
+    g_hash_table_destroy(parameter->callbacks);
+    g_free(parameter->app_name);
+    g_free(parameter);
+}
+
+gboolean ax_parameter_register_callback(AXParameter *parameter,
+    const gchar *name, AXParameterCallback callback, gpointer user_data,
+    GError **error)
+{
+    ParameterCallback *entry = g_new0(ParameterCallback, 1);
+
+    (void) error;
+
+    entry->callback = callback;
+    entry->user_data = user_data;
+    g_hash_table_insert(parameter->callbacks, g_strdup(name), entry);
+
+    return TRUE;
+}
+
+gboolean ax_parameter_get(AXParameter *parameter, const gchar *name,
+    gchar **value, GError **error)
+{
+    const gchar *stored = g_hash_table_lookup(parameter->values, name);
+
+    if (!stored) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+            "No parameter %s", name);
+        return FALSE;
+    }
+
+    *value = g_strdup(stored);
+
+    return TRUE;
+}
+
+gboolean ax_parameter_set(AXParameter *parameter, const gchar *name,
+    const gchar *value, gboolean do_sync, GError **error)
+{
+    (void) do_sync;
+
+    if (!g_hash_table_contains(parameter->values, name)) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+            "No parameter %s", name);
+        return FALSE;
+    }
+
+    g_hash_table_insert(parameter->values, g_strdup(name), g_strdup(value));
+
+    /* Like on the device, callbacks run later from the main loop */
+    g_queue_push_tail(&parameter->changed, g_strdup(name));
+
+    if (!parameter->source) {
+        parameter->source = g_idle_add(notify, parameter);
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,109 @@
+#ifndef INCLUSION_GUARD_AXEVENT_H
+#define INCLUSION_GUARD_AXEVENT_H
+
+/*
+ * Host stand-in for the part of the axevent API the application uses.
+ * Subscribers are fed from the event script named by AXEVENT_SCRIPT, see
+ * host/README.md.
+ */
+
+#include <glib.h>
+
+/**
+ * Connection to the event system
+ */
+typedef struct _AXEventHandler AXEventHandler;
+
+/**
+ * Event with its key-value set and time stamp
+ */
+typedef struct _AXEvent AXEvent;
+
+/**
+ * Keys with optional namespace, value and type
+ */
+typedef struct _AXEventKeyValueSet AXEventKeyValueSet;
+
+/**
+ * Type of a value in a key-value set
+ */
+typedef enum {
+    AX_VALUE_TYPE_INT,
+    AX_VALUE_TYPE_BOOL,
+    AX_VALUE_TYPE_DOUBLE,
+    AX_VALUE_TYPE_STRING,
+    AX_VALUE_TYPE_ELEMENT
+} AXEventValueType;
+
+/**
+ * Called with each event matching a subscription
+ */
+typedef void (*AXSubscriptionCallback)(guint subscription, AXEvent *event,
+    gpointer user_data);
+
+/**
+ * Called when a declaration is complete
+ */
+typedef void (*AXDeclarationCompleteCallback)(guint declaration,
+    gpointer user_data);
+
+AXEventHandler *ax_event_handler_new(void);
+void ax_event_handler_free(AXEventHandler *event_handler);
+
+gboolean ax_event_handler_subscribe(AXEventHandler *event_handler,
+    AXEventKeyValueSet *key_value_set, guint *subscription,
+    AXSubscriptionCallback callback, gpointer user_data, GError **error);
+gboolean ax_event_handler_unsubscribe(AXEventHandler *event_handler,
+    guint subscription, GError **error);
+
+gboolean ax_event_handler_declare(AXEventHandler *event_handler,
+    AXEventKeyValueSet *key_value_set, gboolean stateless,
+    guint *declaration, AXDeclarationCompleteCallback callback,
+    gpointer user_data, GError **error);
+gboolean ax_event_handler_undeclare(AXEventHandler *event_handler,
+    guint declaration, GError **error);
+gboolean ax_event_handler_send_event(AXEventHandler *event_handler,
+    guint declaration, AXEvent *event, GError **error);
+
+AXEventKeyValueSet *ax_event_key_value_set_new(void);
+void ax_event_key_value_set_free(AXEventKeyValueSet *key_value_set);
+
+gboolean ax_event_key_value_set_add_key_value(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, gconstpointer value, AXEventValueType value_type,
+    GError **error);
+gboolean ax_event_key_value_set_add_key_values(
+    AXEventKeyValueSet *key_value_set, GError **error, ...);
+gboolean ax_event_key_value_set_remove_key(AXEventKeyValueSet *key_value_set,
+    const gchar *key, const gchar *name_space, GError **error);
+
+gboolean ax_event_key_value_set_get_boolean(
+    const AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, gboolean *value, GError **error);
+gboolean ax_event_key_value_set_get_integer(
+    const AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, gint *value, GError **error);
+gboolean ax_event_key_value_set_get_string(
+    const AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, gchar **value, GError **error);
+
+gboolean ax_event_key_value_set_mark_as_source(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, GError **error);
+gboolean ax_event_key_value_set_mark_as_data(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, GError **error);
+gboolean ax_event_key_value_set_mark_as_user_defined(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, const gchar *user_tag, GError **error);
+gboolean ax_event_key_value_set_add_nice_names(
+    AXEventKeyValueSet *key_value_set, const gchar *key,
+    const gchar *name_space, const gchar *key_nice_name,
+    const gchar *value_nice_name, GError **error);
+
+AXEvent *ax_event_new(AXEventKeyValueSet *key_value_set,
+    GTimeVal *time_stamp);
+void ax_event_free(AXEvent *event);
+const AXEventKeyValueSet *ax_event_get_key_value_set(AXEvent *event);
+
+#endif // INCLUSION_GUARD_AXEVENT_H
@@ -0,0 +1,29 @@
+#ifndef INCLUSION_GUARD_AXHTTP_H
+#define INCLUSION_GUARD_AXHTTP_H
+
+/*
+ * Host stand-in for the axhttp API. Requests are served on 127.0.0.1 at
+ * the port in AXHTTP_PORT, 8080 by default.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+/**
+ * Handler receiving the application's CGI requests
+ */
+typedef struct _AXHttpHandler AXHttpHandler;
+
+/**
+ * Called with each request, the reply including its headers is written to
+ * output_stream
+ */
+typedef void (*AXHttpRequestCallback)(const gchar *path, const gchar *method,
+    const gchar *query, GHashTable *params, GOutputStream *output_stream,
+    gpointer user_data);
+
+AXHttpHandler *ax_http_handler_new(AXHttpRequestCallback callback,
+    gpointer user_data);
+void ax_http_handler_free(AXHttpHandler *handler);
+
+#endif // INCLUSION_GUARD_AXHTTP_H
@@ -0,0 +1,35 @@
+#ifndef INCLUSION_GUARD_AXPARAMETER_H
+#define INCLUSION_GUARD_AXPARAMETER_H
+
+/*
+ * Host stand-in for the axparameter API. Parameters start out with the
+ * values in the file named by AXPARAMETER_FILE, param.conf by default, and
+ * are kept in memory.
+ */
+
+#include <glib.h>
+
+/**
+ * Parameters of one application
+ */
+typedef struct _AXParameter AXParameter;
+
+/**
+ * Called from the main loop when a parameter changes, name is the full
+ * name root.<App>.<Parameter>
+ */
+typedef void (*AXParameterCallback)(const gchar *name, const gchar *value,
+    gpointer user_data);
+
+AXParameter *ax_parameter_new(const gchar *app_name, GError **error);
+void ax_parameter_free(AXParameter *parameter);
+
+gboolean ax_parameter_register_callback(AXParameter *parameter,
+    const gchar *name, AXParameterCallback callback, gpointer user_data,
+    GError **error);
+gboolean ax_parameter_get(AXParameter *parameter, const gchar *name,
+    gchar **value, GError **error);
+gboolean ax_parameter_set(AXParameter *parameter, const gchar *name,
+    const gchar *value, gboolean do_sync, GError **error);
+
+#endif // INCLUSION_GUARD_AXPARAMETER_H
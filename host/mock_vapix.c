@@ -0,0 +1,620 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cJSON.h"
+#include "overlay_commands.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   g_message("mock_vapix: " fmt, ## args)
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   g_warning("mock_vapix: " fmt, ## args)
+
+/**
+ * Largest request body accepted, overlay uploads carry a whole image
+ */
+#define MAX_BODY            (16 * 1024 * 1024)
+
+/**
+ * Realm and nonce of the digest challenge, the nonce never changes
+ */
+#define REALM               "AXIS_MOCK"
+#define NONCE               "6d6f636b5f7661706978"
+
+/**
+ * Challenge sent when digest authentication is required
+ */
+#define CHALLENGE           "Digest realm=\"" REALM "\", " \
+    "nonce=\"" NONCE "\", algorithm=MD5, qop=\"auth\""
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Reply to one request
+ */
+typedef struct {
+    guint status;
+    const gchar *reason;
+    const gchar *content_type;
+    gchar *body;
+} Reply;
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Port to serve on
+ */
+static gint port = 8081;
+
+/**
+ * Delay in ms added to every reply
+ */
+static gint latency = 0;
+
+/**
+ * Percentage of requests answered with 503
+ */
+static gint error_rate = 0;
+
+/**
+ * Require digest authentication
+ */
+static gboolean digest = FALSE;
+
+/**
+ * Credentials digest responses are checked against, as in param.conf
+ */
+static gchar *username = "root";
+static gchar *password = "pass";
+
+/**
+ * Dynamic overlays added so far, guarded by lock
+ */
+static cJSON *overlays = NULL;
+
+/**
+ * Identity of the next added overlay
+ */
+static gint next_identity = 1;
+
+/**
+ * Number of requests by path, guarded by lock
+ */
+static GHashTable *requests = NULL;
+
+/**
+ * Guards overlays and requests, connections are served on their own threads
+ */
+static GMutex lock;
+
+/**
+ * Command line options
+ */
+static GOptionEntry options[] = {
+    { "port", 'p', 0, G_OPTION_ARG_INT, &port, "Port to serve on", "PORT" },
+    { "latency", 'l', 0, G_OPTION_ARG_INT, &latency,
+        "Delay every reply by MS", "MS" },
+    { "error-rate", 'e', 0, G_OPTION_ARG_INT, &error_rate,
+        "Answer PERCENT of requests with 503", "PERCENT" },
+    { "digest", 'd', 0, G_OPTION_ARG_NONE, &digest,
+        "Require digest authentication", NULL },
+    { "username", 'u', 0, G_OPTION_ARG_STRING, &username,
+        "User for digest authentication, default root", "USER" },
+    { "password", 'w', 0, G_OPTION_ARG_STRING, &password,
+        "Password for digest authentication, default pass", "PASSWORD" },
+    { NULL }
+};
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Find an overlay by identity, NULL if there is none
+ */
+static cJSON *find_overlay(gint identity);
+
+/**
+ * Answer a dynamic overlay API command
+ */
+static gchar *overlay_command(const gchar *body);
+
+/**
+ * Parameters of a digest Authorization header by name, values unquoted
+ */
+static GHashTable *digest_params(const gchar *authorization);
+
+/**
+ * TRUE if authorization holds a valid digest response for the request
+ */
+static gboolean digest_valid(const gchar *method, const gchar *uri,
+    const gchar *authorization);
+
+/**
+ * Answer one request
+ */
+static void handle(const gchar *path, const gchar *body,
+    gboolean authorized, Reply *reply);
+
+/**
+ * Serve the keep-alive requests of one connection
+ */
+static gboolean serve(GThreadedSocketService *service,
+    GSocketConnection *connection, GObject *source_object,
+    gpointer user_data);
+
+/**
+ * Log the request counts and stop
+ */
+static gboolean stop(gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Find an overlay by identity, NULL if there is none
+ */
+static cJSON *find_overlay(gint identity)
+{
+    cJSON *item;
+
+    cJSON_ArrayForEach(item, overlays) {
+        if (cJSON_GetObjectItemCaseSensitive(item, "identity")->valueint ==
+            identity) {
+            return item;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Answer a dynamic overlay API command
+ */
+static gchar *overlay_command(const gchar *body)
+{
+    cJSON *request = cJSON_Parse(body);
+    cJSON *method = cJSON_GetObjectItemCaseSensitive(request, "method");
+    cJSON *params = cJSON_GetObjectItemCaseSensitive(request, "params");
+    cJSON *identity = cJSON_GetObjectItemCaseSensitive(params, "identity");
+    cJSON *response = cJSON_CreateObject();
+    cJSON *data = cJSON_CreateObject();
+    cJSON *item;
+    gchar *text;
+
+    cJSON_AddStringToObject(response, "apiVersion", "1.0");
+    cJSON_AddStringToObject(response, "method",
+        cJSON_IsString(method) ? method->valuestring : "");
+
+    g_mutex_lock(&lock);
+
+    if (!cJSON_IsString(method)) {
+        cJSON_Delete(data);
+        data = NULL;
+    } else if (strcmp(method->valuestring, "addImage") == 0 &&
+        cJSON_IsObject(params)) {
+        item = cJSON_Duplicate(params, TRUE);
+        cJSON_AddNumberToObject(item, "identity", next_identity);
+        cJSON_AddItemToArray(overlays, item);
+        cJSON_AddNumberToObject(data, "identity", next_identity++);
+    } else if (strcmp(method->valuestring, "setImage") == 0 &&
+        cJSON_IsNumber(identity) &&
+        (item = find_overlay(identity->valueint))) {
+        cJSON *position = cJSON_GetObjectItemCaseSensitive(params,
+            "position");
+
+        if (position) {
+            cJSON_ReplaceItemInObjectCaseSensitive(item, "position",
+                cJSON_Duplicate(position, TRUE));
+        }
+    } else if (strcmp(method->valuestring, "remove") == 0 &&
+        cJSON_IsNumber(identity) &&
+        (item = find_overlay(identity->valueint))) {
+        cJSON_Delete(cJSON_DetachItemViaPointer(overlays, item));
+    } else if (strcmp(method->valuestring, "list") == 0) {
+        cJSON_AddItemToObject(data, "imageOverlays",
+            cJSON_Duplicate(overlays, TRUE));
+        cJSON_AddItemToObject(data, "textOverlays", cJSON_CreateArray());
+    } else {
+        cJSON_Delete(data);
+        data = NULL;
+    }
+
+    g_mutex_unlock(&lock);
+
+    if (data) {
+        cJSON_AddItemToObject(response, "data", data);
+    } else {
+        cJSON *error = cJSON_CreateObject();
+
+        cJSON_AddNumberToObject(error, "code", 1000);
+        cJSON_AddStringToObject(error, "message", "Invalid parameter");
+        cJSON_AddItemToObject(response, "error", error);
+    }
+
+    text = cJSON_PrintUnformatted(response);
+
+    cJSON_Delete(response);
+    cJSON_Delete(request);
+
+    return text;
+}
+
+/**
+ * Parameters of a digest Authorization header by name, values unquoted
+ */
+static GHashTable *digest_params(const gchar *authorization)
+{
+    GHashTable *params = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, g_free);
+    const gchar *p = authorization + strlen("Digest ");
+
+    while (*p) {
+        const gchar *name;
+        gsize length;
+        GString *value;
+
+        while (*p == ' ' || *p == ',') {
+            p++;
+        }
+
+        name = p;
+        p = strchr(p, '=');
+
+        if (!p) {
+            break;
+        }
+
+        length = p++ - name;
+        value = g_string_new(NULL);
+
+        if (*p == '"') {
+            for (p++; *p && *p != '"'; p++) {
+                g_string_append_c(value, *p);
+            }
+
+            p += *p ? 1 : 0;
+        } else {
+            for (; *p && *p != ','; p++) {
+                g_string_append_c(value, *p);
+            }
+        }
+
+        g_hash_table_insert(params, g_strstrip(g_strndup(name, length)),
+            g_strstrip(g_string_free(value, FALSE)));
+    }
+
+    return params;
+}
+
+/**
+ * TRUE if authorization holds a valid digest response for the request
+ */
+static gboolean digest_valid(const gchar *method, const gchar *uri,
+    const gchar *authorization)
+{
+    GHashTable *params;
+    const gchar *qop;
+    gchar *ha1;
+    gchar *ha2;
+    gchar *text;
+    gchar *expected;
+    gboolean ret;
+
+    if (!authorization || !g_str_has_prefix(authorization, "Digest ")) {
+        return FALSE;
+    }
+
+    params = digest_params(authorization);
+    qop = g_hash_table_lookup(params, "qop");
+
+    text = g_strdup_printf("%s:%s:%s", username, REALM, password);
+    ha1 = g_compute_checksum_for_string(G_CHECKSUM_MD5, text, -1);
+    g_free(text);
+
+    text = g_strdup_printf("%s:%s", method, uri);
+    ha2 = g_compute_checksum_for_string(G_CHECKSUM_MD5, text, -1);
+    g_free(text);
+
+    if (qop) {
+        text = g_strdup_printf("%s:%s:%s:%s:%s:%s", ha1, NONCE,
+            (const gchar *) g_hash_table_lookup(params, "nc"),
+            (const gchar *) g_hash_table_lookup(params, "cnonce"), qop, ha2);
+    } else {
+        text = g_strdup_printf("%s:%s:%s", ha1, NONCE, ha2);
+    }
+
+    expected = g_compute_checksum_for_string(G_CHECKSUM_MD5, text, -1);
+
+    /* The nonce is fixed, so anything else was not answered to it */
+    ret = g_strcmp0(g_hash_table_lookup(params, "username"), username) == 0 &&
+        g_strcmp0(g_hash_table_lookup(params, "realm"), REALM) == 0 &&
+        g_strcmp0(g_hash_table_lookup(params, "nonce"), NONCE) == 0 &&
+        g_strcmp0(g_hash_table_lookup(params, "uri"), uri) == 0 &&
+        g_strcmp0(g_hash_table_lookup(params, "response"), expected) == 0;
+
+    if (!ret) {
+        ERR("Invalid digest response for %s %s", method, uri);
+    }
+
+    g_free(expected);
+    g_free(text);
+    g_free(ha2);
+    g_free(ha1);
+    g_hash_table_unref(params);
+
+    return ret;
+}
+
+/**
+ * Answer one request
+ */
+static void handle(const gchar *path, const gchar *body,
+    gboolean authorized, Reply *reply)
+{
+    guint *count;
+
+    g_mutex_lock(&lock);
+    count = g_hash_table_lookup(requests, path);
+
+    if (!count) {
+        count = g_new0(guint, 1);
+        g_hash_table_insert(requests, g_strdup(path), count);
+    }
+
+    (*count)++;
+    g_mutex_unlock(&lock);
+
+    if (latency > 0) {
+        g_usleep(latency * 1000);
+    }
+
+    reply->status = 200;
+    reply->reason = "OK";
+    reply->content_type = JSON_TYPE;
+
+    if (!authorized) {
+        reply->status = 401;
+        reply->reason = "Unauthorized";
+        reply->body = g_strdup("");
+    } else if (error_rate > 0 && g_random_int_range(0, 100) < error_rate) {
+        reply->status = 503;
+        reply->reason = "Service Unavailable";
+        reply->body = g_strdup("");
+    } else if (strcmp(path, OVERLAY_CGI) == 0) {
+        reply->body = overlay_command(body);
+    } else if (strcmp(path, WIPER_CGI) == 0) {
+        reply->body = g_strdup("{\"apiVersion\":\"1.0\",\"context\":\"123\","
+            "\"method\":\"start\",\"data\":{}}");
+    } else if (strcmp(path, UPLOAD_CGI) == 0) {
+        reply->content_type = "text/plain";
+        reply->body = g_strdup("OK\r\n");
+    } else {
+        reply->status = 404;
+        reply->reason = "Not Found";
+        reply->body = g_strdup("");
+    }
+}
+
+/**
+ * Serve the keep-alive requests of one connection
+ */
+static gboolean serve(GThreadedSocketService *service,
+    GSocketConnection *connection, GObject *source_object,
+    gpointer user_data)
+{
+    GOutputStream *output = g_io_stream_get_output_stream(
+        G_IO_STREAM(connection));
+    GDataInputStream *input = g_data_input_stream_new(
+        g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+    gboolean keep_alive = TRUE;
+    gchar *line;
+
+    (void) service;
+    (void) source_object;
+    (void) user_data;
+
+    g_filter_input_stream_set_close_base_stream(G_FILTER_INPUT_STREAM(input),
+        FALSE);
+    g_data_input_stream_set_newline_type(input,
+        G_DATA_STREAM_NEWLINE_TYPE_ANY);
+
+    while (keep_alive &&
+        (line = g_data_input_stream_read_line(input, NULL, NULL, NULL))) {
+        gchar **request = g_strsplit(line, " ", 3);
+        gchar *authorization = NULL;
+        gsize content_length = 0;
+        gchar *body = NULL;
+        Reply reply = { 0 };
+        GString *head;
+        gchar *query;
+        gboolean authorized;
+
+        g_free(line);
+
+        if (g_strv_length(request) != 3) {
+            g_strfreev(request);
+            break;
+        }
+
+        while ((line = g_data_input_stream_read_line(input, NULL, NULL,
+            NULL))) {
+            gboolean end = *line == '\0';
+
+            if (g_ascii_strncasecmp(line, "Content-Length:", 15) == 0) {
+                content_length = g_ascii_strtoull(line + 15, NULL, 10);
+            } else if (g_ascii_strncasecmp(line, "Authorization:", 14) == 0) {
+                g_free(authorization);
+                authorization = g_strdup(g_strstrip(line + 14));
+            } else if (g_ascii_strncasecmp(line, "Connection:", 11) == 0) {
+                keep_alive = g_ascii_strcasecmp(g_strstrip(line + 11),
+                    "close") != 0;
+            }
+
+            g_free(line);
+
+            if (end) {
+                break;
+            }
+        }
+
+        if (content_length > MAX_BODY) {
+            g_free(authorization);
+            g_strfreev(request);
+            break;
+        }
+
+        body = g_malloc0(content_length + 1);
+
+        if (!g_input_stream_read_all(G_INPUT_STREAM(input), body,
+            content_length, NULL, NULL, NULL)) {
+            g_free(body);
+            g_free(authorization);
+            g_strfreev(request);
+            break;
+        }
+
+        /* Checked against the whole target, the digest covers the query */
+        authorized = !digest ||
+            digest_valid(request[0], request[1], authorization);
+        query = strchr(request[1], '?');
+
+        if (query) {
+            *query = '\0';
+        }
+
+        handle(request[1], body, authorized, &reply);
+
+        head = g_string_new(NULL);
+        g_string_append_printf(head, "HTTP/1.1 %u %s\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %" G_GSIZE_FORMAT "\r\n",
+            reply.status, reply.reason, reply.content_type,
+            strlen(reply.body));
+
+        if (reply.status == 401) {
+            g_string_append(head, "WWW-Authenticate: " CHALLENGE "\r\n");
+        }
+
+        if (!keep_alive) {
+            g_string_append(head, "Connection: close\r\n");
+        }
+
+        g_string_append(head, "\r\n");
+        g_string_append(head, reply.body);
+
+        if (!g_output_stream_write_all(output, head->str, head->len, NULL,
+            NULL, NULL)) {
+            keep_alive = FALSE;
+        }
+
+        g_string_free(head, TRUE);
+        g_free(reply.body);
+        g_free(body);
+        g_free(authorization);
+        g_strfreev(request);
+    }
+
+    g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+    g_object_unref(input);
+
+    return TRUE;
+}
+
+/**
+ * Log the request counts and stop
+ */
+static gboolean stop(gpointer user_data)
+{
+    GHashTableIter iter;
+    gpointer path;
+    gpointer count;
+
+    g_mutex_lock(&lock);
+    g_hash_table_iter_init(&iter, requests);
+
+    while (g_hash_table_iter_next(&iter, &path, &count)) {
+        LOG("%u requests to %s", *(guint *) count, (gchar *) path);
+    }
+
+    g_mutex_unlock(&lock);
+
+    g_main_loop_quit(user_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Serve the VAPIX CGIs the application uses on 127.0.0.1
+ */
+int main(int argc, char *argv[])
+{
+    GOptionContext *context = g_option_context_new(
+        "- mock VAPIX server for the host build");
+    GInetAddress *loopback;
+    GSocketAddress *address;
+    GSocketService *service;
+    GError *error = NULL;
+    GMainLoop *loop;
+
+    g_option_context_add_main_entries(context, options, NULL);
+
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        ERR("%s", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 1;
+    }
+
+    g_option_context_free(context);
+
+    overlays = cJSON_CreateArray();
+    requests = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    /* A thread per connection, like the keep-alive pool opens them */
+    service = g_threaded_socket_service_new(-1);
+
+    loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    address = g_inet_socket_address_new(loopback, port);
+    g_object_unref(loopback);
+
+    if (!g_socket_listener_add_address(G_SOCKET_LISTENER(service), address,
+        G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL, NULL, &error)) {
+        ERR("Could not listen on port %d: %s", port, error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    g_object_unref(address);
+
+    g_signal_connect(service, "run", G_CALLBACK(serve), NULL);
+    g_socket_service_start(service);
+
+    LOG("Serving VAPIX on 127.0.0.1:%d, latency %d ms, error rate %d%%%s", port,
+        latency, error_rate, digest ? ", digest authentication" : "");
+
+    loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGINT, stop, loop);
+    g_unix_signal_add(SIGTERM, stop, loop);
+    g_main_loop_run(loop);
+
+    g_socket_service_stop(service);
+    g_object_unref(service);
+    g_main_loop_unref(loop);
+    g_hash_table_unref(requests);
+    cJSON_Delete(overlays);
+
+    return 0;
+}
@@ -10,7 +10,15 @@
 
 #include <axsdk/axevent.h>
 
+#include "alarm_rule.h"
+#include "alarm_timing.h"
+#include "event_extract.h"
+#include "event_log.h"
+#include "event_queue.h"
 #include "overlays.h"
+#include "timer_wheel.h"
+#include "vapix.h"
+#include "wiper.h"
 #include "camera/camera.h"
 
 /******************** MACRO DEFINITION SECTION ********************************/
@@ -37,6 +45,29 @@
 #define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
     g_warning(fmt, ## args); }
 
+/**
+ * PTZ preset that starts the wiper when the camera arrives at it
+ */
+#define WIPER_PRESET        2
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Last known state of an APD scenario
+ */
+typedef struct {
+    gboolean active;
+    gint64 time;
+} ScenarioState;
+
+/**
+ * Active scenario of a new rule, restored in the order it went active
+ */
+typedef struct {
+    guint index;
+    gint64 time;
+} ScenarioRestore;
+
 /******************** LOCAL VARIABLE DECLARATION SECTION **********************/
 
 /**
@@ -55,27 +86,63 @@ static AXEventHandler *event_handler;
 static guint output_event_handle;
 
 /**
- * Subscription ID for zone crossing alarm.
+ * Data of the output event, reused for every update. NULL until declared.
+ */
+static AXEventKeyValueSet *output_event_set = NULL;
+
+/**
+ * Alarm state last sent with the output event, declared as FALSE
+ */
+static gboolean output_event_status = FALSE;
+
+/**
+ * Subscription ID for all PTZ presets, events are routed by preset token.
+ */
+static int subscription_preset = -1;
+
+/**
+ * Subscription ID for all APD scenarios, events are routed by scenario name.
+ */
+static guint subscription_apd = 0;
+
+/**
+ * Fields the rules need from preset events, compiled when subscribing
+ */
+static EventExtractor *preset_extractor = NULL;
+
+/**
+ * Fields the rules need from APD events, compiled when subscribing
  */
-static int subscription_scenario1 = -1;
+static EventExtractor *apd_extractor = NULL;
 
 /**
- * Subscription ID for conditional zone alarm.
+ * Combined alarm rule over the APD scenarios, NULL if none is configured
  */
-static int subscription_scenario2 = -1;
+static AlarmRule *alarm_rule = NULL;
 
 /**
- * Current status of APD Zone crossing alarm
+ * Dwell, hold-off and auto-clear timing of the rules of alarm_rule
  */
-static gboolean scenario1_enabled = FALSE;
+static AlarmTiming *alarm_timing = NULL;
 
 /**
- * Current status of APD Conditional zone alarm
+ * Scenario index in alarm_rule plus one by scenario name, swapped together
+ * with the rule
  */
-static gboolean scenario2_enabled = FALSE;
+static GHashTable *scenario_table = NULL;
 
 /**
- * Current "logical" alarm status, i.e. 'AND' of the two alarms
+ * Last known ScenarioState by scenario name, for every scenario seen
+ */
+static GHashTable *scenario_states = NULL;
+
+/**
+ * TRUE once startup parameters are read and rule changes take effect
+ */
+static gboolean rules_started = FALSE;
+
+/**
+ * Current "logical" alarm status, i.e. any rule of alarm_rule being true
  */
 gboolean alarm_status = FALSE;
 
@@ -89,6 +156,31 @@ static char *par_scenario1 = NULL;
  */
 static char *par_scenario2 = NULL;
 
+/**
+ * Current value of alarm rule parameter
+ */
+static char *par_alarm_rule = NULL;
+
+/**
+ * Current value of sequences parameter
+ */
+static char *par_sequences = NULL;
+
+/**
+ * Current value of rule timing parameter
+ */
+static char *par_rule_timing = NULL;
+
+/**
+ * Rule timing the current alarm timing was built from
+ */
+static char *timing_spec = NULL;
+
+/**
+ * Path of the event log to record to, empty to not record
+ */
+static char *par_event_log = NULL;
+
 /**
  * Current value of username parameter
  */
@@ -99,6 +191,26 @@ static char *par_username  = NULL;
  */
 static char *par_password  = NULL;
 
+/**
+ * Current value of overlay mode parameter
+ */
+static char *par_overlay_mode = NULL;
+
+/**
+ * Current value of indicator parameter
+ */
+static char *par_indicator = NULL;
+
+/**
+ * Current value of wiper cooldown parameter
+ */
+static char *par_wiper_cooldown = NULL;
+
+/**
+ * Current value of overlay channels parameter
+ */
+static char *par_overlay_channels = NULL;
+
 /******************** LOCAL FUNCTION DECLARATION SECTION **********************/
 
 /**
@@ -107,20 +219,72 @@ static char *par_password  = NULL;
 static guint declare_external_event();
 
 /**
- * Send an update to third party apps listening for the combined alarm.
+ * Send an update to third party apps listening for the combined alarm,
+ * only if alarm_status changed since the last one.
  */
 static void update_external_event();
 
 /**
- * CB Function for APD events.
+ * CB Function for PTZ preset events.
  */
-static void apd_event_callback(guint subscription,
+static void preset_event_callback(guint subscription,
     AXEvent *event, guint *token);
 
 /**
- * Subscribe to the specified APD Scenario event.
+ * Extract a PTZ preset event that happened at monotonic time into record
+ */
+static void extract_preset_event(guint subscription, AXEvent *event,
+    gint64 time, EventRecord *record);
+
+/**
+ * Subscribe to the PTZ preset events of all presets.
+ */
+static guint preset_event_subscribe();
+
+/**
+ * CB Function for APD events of all scenarios.
+ */
+static void apd_event_callback(guint subscription,
+    AXEvent *event, gpointer user_data);
+
+/**
+ * Extract an APD event that happened at monotonic time into record,
+ * FALSE if it lacks the scenario name or state
+ */
+static gboolean extract_apd_event(guint subscription, AXEvent *event,
+    gint64 time, EventRecord *record);
+
+/**
+ * Process a batch of queued preset and APD events
+ */
+static void process_events(const EventRecord *records, guint count,
+    gpointer user_data);
+
+/**
+ * Feed a replayed event through event extraction with its replay time
+ */
+static void replay_event(const EventRecord *record, gboolean rejected,
+    gpointer user_data);
+
+/**
+ * Subscribe to the events of all APD scenarios.
+ */
+static guint apd_event_subscribe();
+
+/**
+ * Compile the alarm rule from parameters and route its scenarios to it
+ */
+static void update_alarm_rule();
+
+/**
+ * Order restored scenarios by the time they went active
+ */
+static gint compare_restore(gconstpointer a, gconstpointer b);
+
+/**
+ * Callback from the rule timing when the mask of active rules changes
  */
-static guint apd_event_subscribe(int preset_no);
+static void alarm_outputs_changed(guint64 outputs, gpointer user_data);
 
 /**
  * Set alarm status - remove green overlay, add red overlay and update status
@@ -144,16 +308,40 @@ static void init_signals();
 
 /**
  * Callback function for changes to Scenario 1 parameter
- * update APD event subscription
+ * update APD scenario routing
  */
 static void set_scenario1(const char *value);
 
 /**
  * Callback function for changes to Scenario 2 parameter
- * update APD event subscription
+ * update APD scenario routing
  */
 static void set_scenario2(const char *value);
 
+/**
+ * Callback function for changes to AlarmRule parameter
+ * update APD scenario routing
+ */
+static void set_alarm_rule(const char *value);
+
+/**
+ * Callback function for changes to Sequences parameter
+ * update APD scenario routing
+ */
+static void set_sequences(const char *value);
+
+/**
+ * Callback function for changes to RuleTiming parameter
+ * update dwell, hold-off and auto-clear times of the rules
+ */
+static void set_rule_timing(const char *value);
+
+/**
+ * Callback function for changes to EventLog parameter
+ * start or stop recording events
+ */
+static void set_event_log(const char *value);
+
 /**
  * Callback function for changes to Username parameter
  * update overlay API credentials if needed
@@ -166,6 +354,35 @@ static void set_username(const char *value);
  */
 static void set_password(const char *value);
 
+/**
+ * Callback function for changes to OverlayMode parameter
+ * select how overlay states are switched
+ */
+static void set_overlay_mode(const char *value);
+
+/**
+ * Callback function for changes to Indicator parameter
+ * select shipped or rendered overlay images
+ */
+static void set_indicator(const char *value);
+
+/**
+ * Callback function for changes to WiperCooldown parameter
+ * update the minimum time between wiper cycles
+ */
+static void set_wiper_cooldown(const char *value);
+
+/**
+ * Callback function for changes to OverlayChannels parameter
+ * select the channels the overlays are shown on
+ */
+static void set_overlay_channels_param(const char *value);
+
+/**
+ * Serve back runtime status for web page
+ */
+static void api_status(CAMERA_HTTP_Reply http, CAMERA_HTTP_Options options);
+
 /**
  * Serve back parameter values for web page
  */
@@ -178,6 +395,11 @@ static void api_settings_test_reporting(CAMERA_HTTP_Reply http,
 static void api_settings_set(CAMERA_HTTP_Reply http,
                              CAMERA_HTTP_Options options);
 
+/**
+ * Replay an event log through the event callbacks
+ */
+static void api_replay(CAMERA_HTTP_Reply http, CAMERA_HTTP_Options options);
+
 /******************** LOCAL FUNCTION DEFINTION SECTION ************************/
 
 /**
@@ -229,6 +451,11 @@ static guint declare_external_event()
         goto error;
     }
 
+    /* Updates only carry the data, so one set serves all of them */
+    output_event_set = ax_event_key_value_set_new();
+    ax_event_key_value_set_add_key_value(output_event_set, "enabled",
+        "tnsaxis", &enabled, AX_VALUE_TYPE_BOOL, NULL);
+
     error:
 
     ax_event_key_value_set_free(set);
@@ -241,67 +468,82 @@ static guint declare_external_event()
  */
 static void update_external_event()
 {
-    AXEventKeyValueSet *set = ax_event_key_value_set_new();
+    AXEvent *event;
     GTimeVal time_stamp;
+    GError *error = NULL;
 
-    ax_event_key_value_set_add_key_value(set, "enabled", "tnsaxis",
-                                         &alarm_status,
-                                         AX_VALUE_TYPE_BOOL, NULL);
+    /* Nothing to send before the declaration or without an edge */
+    if (!output_event_set || alarm_status == output_event_status) {
+        return;
+    }
 
-    /* Create the event */
-    AXEvent *event = ax_event_new(set, &time_stamp);
+    /* Replaces the previous value of the key */
+    ax_event_key_value_set_add_key_value(output_event_set, "enabled",
+        "tnsaxis", &alarm_status, AX_VALUE_TYPE_BOOL, NULL);
 
-    ax_event_key_value_set_free(set);
+    /* Stamp with the time of the edge */
+    g_get_current_time(&time_stamp);
+
+    /* Create the event */
+    event = ax_event_new(output_event_set, &time_stamp);
 
     /* Send the event */
-    ax_event_handler_send_event(event_handler,
-      output_event_handle,
-      event,
-      NULL);
+    if (ax_event_handler_send_event(event_handler, output_event_handle,
+        event, &error)) {
+        output_event_status = alarm_status;
+    } else {
+        ERR("Could not send combined alarm event: %s",
+            error ? error->message : "unknown error");
+        g_clear_error(&error);
+    }
 
     ax_event_free(event);
 }
 
 /**
- * CB Function for APD events.
+ * CB Function for PTZ preset events.
  */
-static void apd_event_callback(guint subscription,
+static void preset_event_callback(guint subscription,
     AXEvent *event, guint *token)
 {
-    const AXEventKeyValueSet *key_value_set;
-    gboolean enabled;
+    EventRecord record;
 
     (void) token;
 
-    /* Extract the AXEventKeyValueSet from the event. */
-    key_value_set = ax_event_get_key_value_set(event);
-
-    int preset_no = -1;
-    int on_preset = -1;
+    extract_preset_event(subscription, event, g_get_monotonic_time(),
+        &record);
 
-    ax_event_key_value_set_get_boolean(key_value_set,
-        "on_preset", NULL, &on_preset, NULL);
+    /* Logged before queueing, so events the full queue drops are in it */
+    event_log_write(&record, FALSE);
+    event_queue_push(&record);
+}
 
-    ax_event_key_value_set_get_integer(key_value_set,
-        "PresetToken", NULL, &preset_no, NULL);
+/**
+ * Extract a PTZ preset event that happened at monotonic time into record
+ */
+static void extract_preset_event(guint subscription, AXEvent *event,
+    gint64 time, EventRecord *record)
+{
+    const AXEventKeyValueSet *key_value_set;
 
-    
+    memset(record, 0, sizeof(*record));
+    record->kind = EVENT_PRESET;
+    record->subscription = subscription;
+    record->index = (guint) -1;
+    record->active = FALSE;
+    record->time = time;
 
-    LOG("Got preset_no %d, on preset %d", preset_no, on_preset);
+    /* Extract the AXEventKeyValueSet from the event. */
+    key_value_set = ax_event_get_key_value_set(event);
 
-    /**
-     * Only run wiper for second preset
-     */
-    if (preset_no == 2 & on_preset == 1) {
-        LOG("RUNNING WIPER");
-        run_wiper();
-    }
+    /* Fields that are missing keep the defaults above */
+    event_extractor_run(preset_extractor, key_value_set, record);
 }
 
 /**
- * Subscribe to the specified APD Scenario event.
+ * Subscribe to the PTZ preset events of all presets.
  */
-static guint apd_event_subscribe(int preset_no)
+static guint preset_event_subscribe()
 {
     AXEventKeyValueSet *key_value_set;
     guint subscription;
@@ -309,7 +551,14 @@ static guint apd_event_subscribe(int preset_no)
 
     key_value_set = ax_event_key_value_set_new();
 
-    LOG("Subscribing to event %d", preset_no);
+    LOG("Subscribing to preset events");
+
+    event_extractor_free(preset_extractor);
+    preset_extractor = event_extractor_new();
+    event_extractor_add(preset_extractor, "on_preset", NULL, EXTRACT_BOOL,
+        G_STRUCT_OFFSET(EventRecord, active), sizeof(gboolean), FALSE);
+    event_extractor_add(preset_extractor, "PresetToken", NULL, EXTRACT_INT,
+        G_STRUCT_OFFSET(EventRecord, index), sizeof(guint), FALSE);
 
     /* Initialize an AXEventKeyValueSet that matches the manual trigger event.
     *
@@ -324,20 +573,20 @@ static guint apd_event_subscribe(int preset_no)
         "topic0", "tns1", "PTZController", AX_VALUE_TYPE_STRING,
         "topic1", "tnsaxis", "PTZPresets", AX_VALUE_TYPE_STRING,
         "topic2", NULL, "Channel_1", AX_VALUE_TYPE_STRING,
-        "PresetToken", NULL, &preset_no, AX_VALUE_TYPE_INT,
+        "PresetToken", NULL, NULL, AX_VALUE_TYPE_INT,
         "on_preset", NULL, NULL, AX_VALUE_TYPE_INT, NULL);
 
     /* Time to setup the subscription. Use the "token" input argument as
     * input data to the callback function "subscription callback"
     */
     result = ax_event_handler_subscribe(event_handler, key_value_set,
-        &subscription, (AXSubscriptionCallback)apd_event_callback, NULL,
+        &subscription, (AXSubscriptionCallback)preset_event_callback, NULL,
         NULL);
 
     if (!result) {
-        ERR("Failed to subscribe to event %d", preset_no);
+        ERR("Failed to subscribe to preset events");
     } else {
-        LOG("Subscribing to event %d", preset_no);
+        LOG("Subscribed to preset events");
     }
 
     /* The key/value set is no longer needed */
@@ -346,6 +595,355 @@ static guint apd_event_subscribe(int preset_no)
     return subscription;
 }
 
+/**
+ * CB Function for APD events of all scenarios.
+ */
+static void apd_event_callback(guint subscription,
+    AXEvent *event, gpointer user_data)
+{
+    EventRecord record;
+    gboolean valid;
+
+    (void) user_data;
+
+    valid = extract_apd_event(subscription, event, g_get_monotonic_time(),
+        &record);
+
+    /* Every event is logged, rejected ones too, before the queue can drop it */
+    event_log_write(&record, !valid);
+
+    if (valid) {
+        event_queue_push(&record);
+    }
+}
+
+/**
+ * Extract an APD event that happened at monotonic time into record,
+ * FALSE if it lacks the scenario name or state
+ */
+static gboolean extract_apd_event(guint subscription, AXEvent *event,
+    gint64 time, EventRecord *record)
+{
+    const AXEventKeyValueSet *key_value_set;
+
+    memset(record, 0, sizeof(*record));
+    record->kind = EVENT_SCENARIO;
+    record->subscription = subscription;
+    record->time = time;
+
+    key_value_set = ax_event_get_key_value_set(event);
+
+    /* The scenario name routes the event to the rule when drained */
+    return event_extractor_run(apd_extractor, key_value_set, record);
+}
+
+/**
+ * Process a batch of queued preset and APD events
+ */
+static void process_events(const EventRecord *records, guint count,
+    gpointer user_data)
+{
+    gboolean changed = FALSE;
+    ScenarioState *state;
+    guint index;
+    guint i;
+
+    (void) user_data;
+
+    for (i = 0; i < count; i++) {
+        const EventRecord *record = &records[i];
+
+        if (record->kind == EVENT_PRESET) {
+            LOG("Got preset_no %d, on preset %d", (int) record->index,
+                record->active);
+
+            /**
+             * Only run wiper for second preset
+             */
+            if (record->index == WIPER_PRESET && record->active) {
+                wiper_request();
+            }
+
+            continue;
+        }
+
+        /* Remember every scenario, a later rule may refer to it */
+        state = g_hash_table_lookup(scenario_states, record->topic);
+
+        if (!state) {
+            state = g_new0(ScenarioState, 1);
+            g_hash_table_insert(scenario_states, g_strdup(record->topic),
+                state);
+        }
+
+        state->active = record->active;
+        state->time = record->time;
+
+        /* Scenarios no rule refers to end here */
+        index = scenario_table ? GPOINTER_TO_UINT(
+            g_hash_table_lookup(scenario_table, record->topic)) : 0;
+
+        if (!alarm_rule || index == 0) {
+            continue;
+        }
+
+        alarm_rule_set(alarm_rule, index - 1, record->active, record->time);
+        changed = TRUE;
+    }
+
+    /* One evaluation for the whole batch */
+    if (changed) {
+        alarm_timing_update(alarm_timing, alarm_rule_evaluate(alarm_rule));
+    }
+}
+
+/**
+ * Subscribe to the events of all APD scenarios.
+ */
+static guint apd_event_subscribe()
+{
+    AXEventKeyValueSet *key_value_set;
+    guint subscription = 0;
+
+    key_value_set = ax_event_key_value_set_new();
+
+    event_extractor_free(apd_extractor);
+    apd_extractor = event_extractor_new();
+    event_extractor_add(apd_extractor, "active", NULL, EXTRACT_BOOL,
+        G_STRUCT_OFFSET(EventRecord, active), sizeof(gboolean), TRUE);
+    event_extractor_add(apd_extractor, "topic2", "tnsaxis", EXTRACT_STRING,
+        G_STRUCT_OFFSET(EventRecord, topic), EVENT_TOPIC_SIZE, TRUE);
+
+    /* tnsaxis:topic0=CameraApplicationPlatform
+     * tnsaxis:topic1=PerimeterDefender
+     * tnsaxis:topic2=*  <-- Subscribe to all scenarios
+     * active=*          <-- Subscribe to all states
+     */
+    ax_event_key_value_set_add_key_values(key_value_set,
+        NULL,
+        "topic0", "tnsaxis", "CameraApplicationPlatform", AX_VALUE_TYPE_STRING,
+        "topic1", "tnsaxis", "PerimeterDefender", AX_VALUE_TYPE_STRING,
+        "topic2", "tnsaxis", NULL, AX_VALUE_TYPE_STRING,
+        "active", NULL, NULL, AX_VALUE_TYPE_BOOL, NULL);
+
+    if (!ax_event_handler_subscribe(event_handler, key_value_set,
+        &subscription, (AXSubscriptionCallback)apd_event_callback,
+        NULL, NULL)) {
+        ERR("Failed to subscribe to APD scenarios");
+    } else {
+        LOG("Subscribed to APD scenarios");
+    }
+
+    ax_event_key_value_set_free(key_value_set);
+
+    return subscription;
+}
+
+/**
+ * Feed a replayed event through event extraction as if it came from the
+ * event system, so extraction is part of what a replay exercises. The
+ * event keeps the time the replay gives it instead of the time it arrives.
+ * Replayed events are not logged again.
+ */
+static void replay_event(const EventRecord *record, gboolean rejected,
+    gpointer user_data)
+{
+    AXEventKeyValueSet *key_value_set = ax_event_key_value_set_new();
+    AXEvent *event;
+    EventRecord replayed;
+    GTimeVal time_stamp;
+    gint index = record->index;
+    gboolean active = record->active;
+
+    (void) user_data;
+
+    if (record->kind == EVENT_PRESET) {
+        ax_event_key_value_set_add_key_values(key_value_set, NULL,
+            "topic0", "tns1", "PTZController", AX_VALUE_TYPE_STRING,
+            "topic1", "tnsaxis", "PTZPresets", AX_VALUE_TYPE_STRING,
+            "topic2", NULL, "Channel_1", AX_VALUE_TYPE_STRING,
+            "PresetToken", NULL, &index, AX_VALUE_TYPE_INT,
+            "on_preset", NULL, &active, AX_VALUE_TYPE_BOOL, NULL);
+    } else {
+        ax_event_key_value_set_add_key_values(key_value_set, NULL,
+            "topic0", "tnsaxis", "CameraApplicationPlatform",
+            AX_VALUE_TYPE_STRING,
+            "topic1", "tnsaxis", "PerimeterDefender", AX_VALUE_TYPE_STRING,
+            "active", NULL, &active, AX_VALUE_TYPE_BOOL, NULL);
+
+        /* Without the scenario name a rejected event is rejected again */
+        if (!rejected) {
+            ax_event_key_value_set_add_key_value(key_value_set, "topic2",
+                "tnsaxis", record->topic, AX_VALUE_TYPE_STRING, NULL);
+        }
+    }
+
+    g_get_current_time(&time_stamp);
+    event = ax_event_new(key_value_set, &time_stamp);
+
+    if (record->kind == EVENT_PRESET) {
+        extract_preset_event(subscription_preset, event, record->time,
+            &replayed);
+        event_queue_push(&replayed);
+    } else if (extract_apd_event(subscription_apd, event, record->time,
+        &replayed)) {
+        event_queue_push(&replayed);
+    }
+
+    ax_event_free(event);
+    ax_event_key_value_set_free(key_value_set);
+}
+
+/**
+ * Order restored scenarios by the time they went active
+ */
+static gint compare_restore(gconstpointer a, gconstpointer b)
+{
+    const ScenarioRestore *x = a;
+    const ScenarioRestore *y = b;
+
+    if (x->time != y->time) {
+        return x->time < y->time ? -1 : 1;
+    }
+
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/**
+ * Compile the alarm rule from parameters and route its scenarios to it
+ */
+static void update_alarm_rule()
+{
+    GString *expression = g_string_new(par_alarm_rule);
+    AlarmRule *rule = NULL;
+    AlarmTiming *timing = NULL;
+    GArray *restore;
+    guint i;
+
+    if (!rules_started) {
+        g_string_free(expression, TRUE);
+        return;
+    }
+
+    /**
+     * Without a rule, the combined alarm is both scenarios being active.
+     * The names are quoted since scenario names may hold spaces.
+     */
+    if (expression->len == 0) {
+        const char *scenarios[] = { par_scenario1, par_scenario2 };
+
+        for (i = 0; i < G_N_ELEMENTS(scenarios); i++) {
+            if (scenarios[i] && *scenarios[i]) {
+                g_string_append_printf(expression, "%s\"%s\"",
+                    expression->len ? " & " : "", scenarios[i]);
+            }
+        }
+    }
+
+    if (expression->len > 0) {
+        rule = alarm_rule_new(expression->str, par_sequences);
+
+        /* Same rules and times, keep the running timing as it is */
+        if (rule && alarm_timing &&
+            alarm_rule_count(rule) == alarm_rule_count(alarm_rule) &&
+            g_strcmp0(par_rule_timing, timing_spec) == 0) {
+            timing = alarm_timing;
+        } else if (rule) {
+            timing = alarm_timing_new(par_rule_timing,
+                alarm_rule_count(rule), alarm_outputs_changed, NULL);
+
+            /* Outputs already on stay on and latches stay latched */
+            if (timing && alarm_timing) {
+                alarm_timing_inherit(timing, alarm_timing);
+            }
+        }
+
+        if (!timing) {
+            /* Keep running with the previous rule */
+            alarm_rule_free(rule);
+            g_string_free(expression, TRUE);
+            return;
+        }
+    }
+
+    LOG("Using alarm rule '%s'", expression->str);
+    g_string_free(expression, TRUE);
+
+    /* The subscription stays, only the routing table is swapped */
+    if (scenario_table) {
+        g_hash_table_unref(scenario_table);
+        scenario_table = NULL;
+    }
+
+    alarm_rule_free(alarm_rule);
+    alarm_rule = rule;
+
+    if (timing != alarm_timing) {
+        alarm_timing_free(alarm_timing);
+        alarm_timing = timing;
+    }
+
+    g_free(timing_spec);
+    timing_spec = g_strdup(par_rule_timing);
+
+    if (!alarm_rule) {
+        clear_alarm();
+        return;
+    }
+
+    scenario_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+        NULL);
+    restore = g_array_new(FALSE, FALSE, sizeof(ScenarioRestore));
+
+    for (i = 0; i < alarm_rule_scenario_count(alarm_rule); i++) {
+        const char *scenario = alarm_rule_scenario(alarm_rule, i);
+        ScenarioState *state = g_hash_table_lookup(scenario_states,
+            scenario);
+
+        g_hash_table_insert(scenario_table, g_strdup(scenario),
+            GUINT_TO_POINTER(i + 1));
+
+        /* Start from the last known state, unknown scenarios are inactive */
+        if (state && state->active) {
+            ScenarioRestore entry = { i, state->time };
+
+            g_array_append_val(restore, entry);
+        }
+    }
+
+    /* Sequences only match activations fed in the order they happened */
+    g_array_sort(restore, compare_restore);
+
+    for (i = 0; i < restore->len; i++) {
+        const ScenarioRestore *entry = &g_array_index(restore,
+            ScenarioRestore, i);
+
+        alarm_rule_set(alarm_rule, entry->index, TRUE, entry->time);
+    }
+
+    g_array_free(restore, TRUE);
+
+    alarm_timing_update(alarm_timing, alarm_rule_evaluate(alarm_rule));
+
+    if (alarm_timing_outputs(alarm_timing) == 0) {
+        clear_alarm();
+    }
+}
+
+/**
+ * Callback from the rule timing when the mask of active rules changes
+ */
+static void alarm_outputs_changed(guint64 outputs, gpointer user_data)
+{
+    (void) user_data;
+
+    if (outputs != 0) {
+        set_alarm();
+    } else {
+        clear_alarm();
+    }
+}
+
 /**
  * Set alarm status - remove green overlay, add red overlay and update status
  */
@@ -357,6 +955,7 @@ static void set_alarm()
     }
 
     alarm_status = TRUE;
+    update_external_event();
 }
 
 /**
@@ -370,6 +969,7 @@ static void clear_alarm()
     }
 
     alarm_status = FALSE;
+    update_external_event();
 }
 
 /**
@@ -400,7 +1000,7 @@ static void init_signals()
 
 /**
  * Callback function for changes to Scenario 1 parameter
- * update APD event subscription
+ * update APD scenario routing
  */
 static void set_scenario1(const char *value)
 {
@@ -410,20 +1010,16 @@ static void set_scenario1(const char *value)
 
         LOG("Got new Scenario1 %s", par_scenario1);
 
-        /* Unsubscribe to any previous event */
-        if (subscription_scenario1 != -1) {
-            LOG("Unsubscribing to event %d", subscription_scenario1);
-            ax_event_handler_unsubscribe(event_handler, subscription_scenario1,
-                NULL);
+        /* Only the default rule is built from the scenarios */
+        if (!par_alarm_rule || !*par_alarm_rule) {
+            update_alarm_rule();
         }
-
-        subscription_scenario1 = apd_event_subscribe(1);
     }
 }
 
 /**
  * Callback function for changes to Scenario 2 parameter
- * update APD event subscription
+ * update APD scenario routing
  */
 static void set_scenario2(const char *value)
 {
@@ -433,14 +1029,74 @@ static void set_scenario2(const char *value)
 
         LOG("Got new Scenario2 %s", par_scenario2);
 
-        /* Unsubscribe to any previous event */
-        if (subscription_scenario2 != -1) {
-            LOG("Unsubscribing to event %d", subscription_scenario2);
-            ax_event_handler_unsubscribe(event_handler, subscription_scenario2,
-                NULL);
+        /* Only the default rule is built from the scenarios */
+        if (!par_alarm_rule || !*par_alarm_rule) {
+            update_alarm_rule();
         }
+    }
+}
+
+/**
+ * Callback function for changes to AlarmRule parameter
+ * update APD scenario routing
+ */
+static void set_alarm_rule(const char *value)
+{
+    if (g_strcmp0(value, par_alarm_rule) != 0) {
+        g_free(par_alarm_rule);
+        par_alarm_rule = g_strdup(value);
+
+        LOG("Got new AlarmRule %s", par_alarm_rule);
+
+        update_alarm_rule();
+    }
+}
+
+/**
+ * Callback function for changes to Sequences parameter
+ * update APD scenario routing
+ */
+static void set_sequences(const char *value)
+{
+    if (g_strcmp0(value, par_sequences) != 0) {
+        g_free(par_sequences);
+        par_sequences = g_strdup(value);
+
+        LOG("Got new Sequences %s", par_sequences);
+
+        update_alarm_rule();
+    }
+}
+
+/**
+ * Callback function for changes to RuleTiming parameter
+ * update dwell, hold-off and auto-clear times of the rules
+ */
+static void set_rule_timing(const char *value)
+{
+    if (g_strcmp0(value, par_rule_timing) != 0) {
+        g_free(par_rule_timing);
+        par_rule_timing = g_strdup(value);
+
+        LOG("Got new RuleTiming %s", par_rule_timing);
 
-        subscription_scenario2 = apd_event_subscribe(2);
+        update_alarm_rule();
+    }
+}
+
+/**
+ * Callback function for changes to EventLog parameter
+ * start or stop recording events
+ */
+static void set_event_log(const char *value)
+{
+    if (g_strcmp0(value, par_event_log) != 0) {
+        g_free(par_event_log);
+        par_event_log = g_strdup(value);
+
+        LOG("Got new EventLog %s", par_event_log);
+
+        event_log_open(par_event_log);
     }
 }
 
@@ -480,6 +1136,94 @@ static void set_password(const char *value)
     }
 }
 
+/**
+ * Callback function for changes to OverlayMode parameter
+ * select how overlay states are switched
+ */
+static void set_overlay_mode(const char *value)
+{
+    if (g_strcmp0(value, par_overlay_mode) != 0) {
+        g_free(par_overlay_mode);
+        par_overlay_mode = g_strdup(value);
+
+        LOG("Got new OverlayMode %s", par_overlay_mode);
+
+        set_overlay_preload(g_strcmp0(par_overlay_mode, "preload") == 0);
+    }
+}
+
+/**
+ * Callback function for changes to Indicator parameter
+ * select shipped or rendered overlay images
+ */
+static void set_indicator(const char *value)
+{
+    if (g_strcmp0(value, par_indicator) != 0) {
+        g_free(par_indicator);
+        par_indicator = g_strdup(value);
+
+        LOG("Got new Indicator %s", par_indicator);
+
+        set_overlay_indicator(par_indicator);
+    }
+}
+
+/**
+ * Callback function for changes to WiperCooldown parameter
+ * update the minimum time between wiper cycles
+ */
+static void set_wiper_cooldown(const char *value)
+{
+    if (g_strcmp0(value, par_wiper_cooldown) != 0) {
+        g_free(par_wiper_cooldown);
+        par_wiper_cooldown = g_strdup(value);
+
+        LOG("Got new WiperCooldown %s", par_wiper_cooldown);
+
+        wiper_set_cooldown(strtoul(par_wiper_cooldown, NULL, 10));
+    }
+}
+
+/**
+ * Callback function for changes to OverlayChannels parameter
+ * select the channels the overlays are shown on
+ */
+static void set_overlay_channels_param(const char *value)
+{
+    if (g_strcmp0(value, par_overlay_channels) != 0) {
+        g_free(par_overlay_channels);
+        par_overlay_channels = g_strdup(value);
+
+        LOG("Got new OverlayChannels %s", par_overlay_channels);
+
+        set_overlay_channels(par_overlay_channels);
+    }
+}
+
+/**
+ * Serve back runtime status for web page
+ */
+static void api_status(CAMERA_HTTP_Reply http, CAMERA_HTTP_Options options)
+{
+  GString *xml = g_string_new("<status>");
+
+  wiper_report(xml);
+
+  if (alarm_rule) {
+    alarm_rule_report(alarm_rule, xml);
+  }
+  timer_wheel_report(xml);
+  event_queue_report(xml);
+  event_log_report(xml);
+  vapix_report(xml);
+  g_string_append(xml, "</status>");
+
+  camera_http_sendXMLheader(http);
+  camera_http_output(http, "%s", xml->str);
+
+  g_string_free(xml, TRUE);
+}
+
 /**
  * Update parameters based on web page input (Used for SaveAll feature)
  */
@@ -496,6 +1240,22 @@ static void api_settings_get(CAMERA_HTTP_Reply http,
     par_username);
   camera_http_output(http, "<param name='Password' value='%s'/>",
     par_password);
+  camera_http_output(http, "<param name='OverlayMode' value='%s'/>",
+    par_overlay_mode);
+  camera_http_output(http, "<param name='Indicator' value='%s'/>",
+    par_indicator);
+  camera_http_output(http, "<param name='WiperCooldown' value='%s'/>",
+    par_wiper_cooldown);
+  camera_http_output(http, "<param name='OverlayChannels' value='%s'/>",
+    par_overlay_channels);
+  camera_http_output(http, "<param name='AlarmRule' value='%s'/>",
+    par_alarm_rule);
+  camera_http_output(http, "<param name='Sequences' value='%s'/>",
+    par_sequences);
+  camera_http_output(http, "<param name='RuleTiming' value='%s'/>",
+    par_rule_timing);
+  camera_http_output(http, "<param name='EventLog' value='%s'/>",
+    par_event_log);
   camera_http_output(http, "</settings>");
 }
 
@@ -531,6 +1291,42 @@ static void api_settings_set(CAMERA_HTTP_Reply http,
   camera_http_output(http, "<success/>");
 }
 
+/**
+ * Replay an event log through the event callbacks, file defaults to the
+ * EventLog parameter and speed to 1 (as recorded), 0 replays at full speed
+ */
+static void api_replay(CAMERA_HTTP_Reply http, CAMERA_HTTP_Options options)
+{
+  const char *file;
+  const char *speed;
+
+  camera_http_sendXMLheader(http);
+
+  file = camera_http_getOptionByName(options, "file");
+  speed = camera_http_getOptionByName(options, "speed");
+
+  if (!file || *file == '\0') {
+    file = par_event_log;
+  }
+
+  if (!file || *file == '\0') {
+    camera_http_output(http, "<error description='Syntax: file missing'/>");
+
+    ERR("api_replay: file is missing\n");
+    return;
+  }
+
+  if (!event_log_replay(file, speed ? g_ascii_strtod(speed, NULL) : 1.0,
+      replay_event, NULL)) {
+    camera_http_output(http, "<error description='Could not replay %s'/>",
+        file);
+
+    ERR("api_replay: Could not replay %s\n", file);
+    return;
+  }
+  camera_http_output(http, "<success/>");
+}
+
 /******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
 
 /**
@@ -548,7 +1344,12 @@ int main(int argc, char *argv[])
     /* Create an AXEventHandler */
     event_handler = ax_event_handler_new();
 
-    char value[50];
+    /* Events are only copied in the callbacks and processed from here */
+    event_queue_init(process_events, NULL);
+    scenario_states = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+        g_free);
+
+    char value[256];
     if(camera_param_get("Scenario1", value, 50)) {
         set_scenario1(value);
     }
@@ -557,6 +1358,15 @@ int main(int argc, char *argv[])
         set_scenario2(value);
     }
 
+    /* Overlay names must be known before the existing ones are adopted */
+    if(camera_param_get("Indicator", value, 50)) {
+        set_indicator(value);
+    }
+
+    if(camera_param_get("OverlayChannels", value, 256)) {
+        set_overlay_channels_param(value);
+    }
+
     if(camera_param_get("Username", value, 50)) {
         set_username(value);
     }
@@ -565,18 +1375,62 @@ int main(int argc, char *argv[])
         set_password(value);
     }
 
+    if(camera_param_get("OverlayMode", value, 50)) {
+        set_overlay_mode(value);
+    }
+
+    if(camera_param_get("WiperCooldown", value, 50)) {
+        set_wiper_cooldown(value);
+    }
+
+    if(camera_param_get("AlarmRule", value, 256)) {
+        set_alarm_rule(value);
+    }
+
+    if(camera_param_get("Sequences", value, 256)) {
+        set_sequences(value);
+    }
+
+    if(camera_param_get("RuleTiming", value, 256)) {
+        set_rule_timing(value);
+    }
+
+    if(camera_param_get("EventLog", value, 256)) {
+        set_event_log(value);
+    }
+
+    /* Subscribe once all scenario parameters and credentials are known */
+    rules_started = TRUE;
+    update_alarm_rule();
+
+    subscription_preset = preset_event_subscribe();
+    subscription_apd = apd_event_subscribe();
+
     camera_param_setCallback("Scenario1", set_scenario1);
     camera_param_setCallback("Scenario2", set_scenario2);
+    camera_param_setCallback("AlarmRule", set_alarm_rule);
+    camera_param_setCallback("Sequences", set_sequences);
+    camera_param_setCallback("RuleTiming", set_rule_timing);
+    camera_param_setCallback("EventLog", set_event_log);
     camera_param_setCallback("Username", set_username);
     camera_param_setCallback("Password", set_password);
+    camera_param_setCallback("OverlayMode", set_overlay_mode);
+    camera_param_setCallback("Indicator", set_indicator);
+    camera_param_setCallback("WiperCooldown", set_wiper_cooldown);
+    camera_param_setCallback("OverlayChannels", set_overlay_channels_param);
 
     camera_http_setCallback("settings/get", api_settings_get);
     camera_http_setCallback("settings/set", api_settings_set);
+    camera_http_setCallback("status", api_status);
+    camera_http_setCallback("replay", api_replay);
 
     output_event_handle = declare_external_event();
 
     LOG("Got external event declaration: %d", output_event_handle);
 
+    /* The rules may have raised the alarm before the declaration */
+    update_external_event();
+
     g_main_loop_run(loop);
     g_main_loop_unref(loop);
 
@@ -585,11 +1439,40 @@ int main(int argc, char *argv[])
     camera_cleanup();
     closelog();
     cleanup_overlays();
+    wiper_cleanup();
 
     g_free(par_scenario1);
     g_free(par_scenario2);
+    g_free(par_alarm_rule);
+    g_free(par_sequences);
+    g_free(par_rule_timing);
+    g_free(timing_spec);
+    g_free(par_event_log);
     g_free(par_username);
     g_free(par_password);
+    g_free(par_overlay_mode);
+    g_free(par_indicator);
+    g_free(par_wiper_cooldown);
+    g_free(par_overlay_channels);
+
+    event_log_cleanup();
+    event_queue_cleanup();
+
+    if (output_event_set) {
+        ax_event_key_value_set_free(output_event_set);
+    }
+
+    alarm_timing_free(alarm_timing);
+    alarm_rule_free(alarm_rule);
+    timer_wheel_cleanup();
+
+    if (scenario_table) {
+        g_hash_table_unref(scenario_table);
+    }
+
+    g_hash_table_unref(scenario_states);
+    event_extractor_free(preset_extractor);
+    event_extractor_free(apd_extractor);
 
     /* TODO: This locks the program on termination for some reason.
     ax_event_handler_free(event_handler);
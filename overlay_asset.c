@@ -0,0 +1,158 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "asset_cache.h"
+#include "overlay_asset.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
+    g_warning(fmt, ## args); }
+
+/**
+ * Size of the fixed .orle header before the palette
+ */
+#define ORLE_HEADER_SIZE    9
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Store a 32-bit little endian value
+ */
+static void put_le32(guint8 *p, guint32 value);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Store a 32-bit little endian value
+ */
+static void put_le32(guint8 *p, guint32 value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Allocate a zeroed 24-bit BMP with headers filled in.
+ */
+guint8 *overlay_asset_bmp_new(guint width, guint height, gsize *stride,
+    gsize *size)
+{
+    gsize row = (width * 3 + 3) & ~3U;
+    gsize image_size = row * height;
+    guint8 *bmp = g_malloc0(OVERLAY_BMP_HEADER + image_size);
+
+    bmp[0] = 'B';
+    bmp[1] = 'M';
+    put_le32(bmp + 2, OVERLAY_BMP_HEADER + image_size);
+    put_le32(bmp + 10, OVERLAY_BMP_HEADER);
+    put_le32(bmp + 14, 40);
+    put_le32(bmp + 18, width);
+    put_le32(bmp + 22, height);
+    bmp[26] = 1;
+    bmp[28] = 24;
+    put_le32(bmp + 34, image_size);
+    put_le32(bmp + 38, 3780);
+    put_le32(bmp + 42, 3780);
+
+    *stride = row;
+    *size = OVERLAY_BMP_HEADER + image_size;
+
+    return bmp;
+}
+
+/**
+ * Expand a compact asset held in memory into a 24-bit BMP image.
+ */
+GBytes *overlay_asset_expand(const guint8 *data, gsize length)
+{
+    const guint8 *palette;
+    const guint8 *run;
+    const guint8 *end = data + length;
+    guint width, height, colors, x = 0, y = 0;
+    gsize stride;
+    gsize size;
+    guint8 *bmp;
+    guint8 *row;
+
+    if (length < ORLE_HEADER_SIZE || memcmp(data, "ORLE", 4) != 0) {
+        return NULL;
+    }
+
+    width  = data[4] | (data[5] << 8);
+    height = data[6] | (data[7] << 8);
+    colors = data[8];
+    palette = data + ORLE_HEADER_SIZE;
+    run = palette + colors * 3;
+
+    if (width == 0 || height == 0 || colors == 0 || run > end) {
+        return NULL;
+    }
+
+    bmp = overlay_asset_bmp_new(width, height, &stride, &size);
+    row = bmp + OVERLAY_BMP_HEADER;
+
+    for (; run + 1 < end && y < height; run += 2) {
+        guint count = run[0];
+        const guint8 *color = palette + run[1] * 3;
+
+        if (run[1] >= colors) {
+            break;
+        }
+
+        while (count-- > 0 && y < height) {
+            memcpy(row + x * 3, color, 3);
+
+            if (++x == width) {
+                x = 0;
+                y++;
+                row += stride;
+            }
+        }
+    }
+
+    if (y != height) {
+        g_free(bmp);
+        return NULL;
+    }
+
+    return g_bytes_new_take(bmp, size);
+}
+
+/**
+ * Read a compact asset file and expand it into a 24-bit BMP image.
+ */
+GBytes *overlay_asset_load(const char *path, gchar **hash)
+{
+    gchar *contents;
+    gsize length;
+    GBytes *image;
+
+    if (!g_file_get_contents(path, &contents, &length, NULL)) {
+        return NULL;
+    }
+
+    image = overlay_asset_expand((const guint8 *) contents, length);
+
+    if (!image) {
+        ERR("Malformed overlay asset %s", path);
+    } else if (hash) {
+        *hash = asset_cache_hash(contents, length);
+    }
+
+    g_free(contents);
+
+    return image;
+}
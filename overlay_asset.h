@@ -0,0 +1,41 @@
+#ifndef INCLUSION_GUARD_OVERLAY_ASSET_H
+#define INCLUSION_GUARD_OVERLAY_ASSET_H
+
+/**
+ * Compact overlay asset (.orle), generated from BMP by tools/bmp2orle at
+ * build time. All values are little endian:
+ *
+ *   "ORLE"                 magic
+ *   u16 width, u16 height  image size in pixels
+ *   u8  colors             palette size, 1..255
+ *   colors * (B, G, R)     palette
+ *   (u8 length, u8 index)  runs of 1..255 pixels, bottom-up rows as in BMP
+ */
+
+/**
+ * Size of the BMP headers in front of the pixel rows
+ */
+#define OVERLAY_BMP_HEADER  54
+
+/**
+ * Allocate a zeroed 24-bit BMP with headers filled in. The bottom-up pixel
+ * rows start OVERLAY_BMP_HEADER bytes in, stride receives the row size and
+ * size the total size. Free with g_free() or hand to g_bytes_new_take().
+ */
+guint8 *overlay_asset_bmp_new(guint width, guint height, gsize *stride,
+    gsize *size);
+
+/**
+ * Expand a compact asset held in memory into a 24-bit BMP image.
+ * Returns NULL if the data is malformed.
+ */
+GBytes *overlay_asset_expand(const guint8 *data, gsize length);
+
+/**
+ * Read a compact asset file and expand it into a 24-bit BMP image.
+ * If hash is non-NULL it receives the content hash of the file, free it
+ * with g_free(). Returns NULL if the file is missing or malformed.
+ */
+GBytes *overlay_asset_load(const char *path, gchar **hash);
+
+#endif // INCLUSION_GUARD_OVERLAY_ASSET_H
@@ -1,31 +1,60 @@
 #ifndef INCLUSION_GUARD_OVERLAY_COMMANDS_H
 #define INCLUSION_GUARD_OVERLAY_COMMANDS_H
 
-#define UPLOAD_BASE "curl --data \"usetransparent=true&colorcode=FFFFFF&usescalabl\
-e=true&type=fullcolor&ov_path=%%2Fusr%%2Flocal%%2Fpackages%%2Fapdcustomalarms%%2F\
-%s\" http://127.0.0.1/axis-cgi/operator/create_overlay.cgi --user\
- %s:%s --anyauth > /tmp/curl.txt 2> /dev/null"
+/* Overridden by the host build, which runs from the source tree */
+#ifndef PACKAGE_DIR
+#define PACKAGE_DIR "/usr/local/packages/apdcustomalarms"
+#endif
 
-#define SET_BASE "curl --anyauth -H \"Content-Type: application/json\" --d\
-ata \"{ \\\"apiVersion\\\": \\\"1.0\\\", \\\"context\\\": \\\"123\\\",\\\"method\\\": \\\"addImage\\\",\\\"\
-params\\\": {\\\"camera\\\": 1,\\\"overlayPath\\\": \\\"/etc/overlays/%s\\\",\\\"\
-position\\\": [0.66, -1.0],\\\"zIndex\\\": 1 }}\" http://127.0.0.1/axis-cgi/dynamicover\
-lay/dynamicoverlay.cgi --user %s:%s > /tmp/curl.txt 2> /dev/null"
+#define OVERLAY_DIR "/etc/overlays"
+
+#define ASSET_CACHE PACKAGE_DIR "/localdata/overlay_assets.cache"
+
+#define UPLOAD_CGI  "/axis-cgi/operator/create_overlay.cgi"
+
+#define OVERLAY_CGI "/axis-cgi/dynamicoverlay/dynamicoverlay.cgi"
+
+#define WIPER_CGI   "/axis-cgi/clearviewcontrol.cgi"
+
+#define JSON_TYPE   "application/json"
+
+#define MULTIPART_BOUNDARY "apdcustomalarms-overlay-upload"
+
+#define MULTIPART_TYPE "multipart/form-data; boundary=" MULTIPART_BOUNDARY
+
+/* Upload options as form fields, then the image itself as a file part */
+#define MULTIPART_FIELD "--" MULTIPART_BOUNDARY "\r\nContent-Disposition: \
+form-data; name=\"%s\"\r\n\r\n%s\r\n"
+
+#define MULTIPART_FILE "--" MULTIPART_BOUNDARY "\r\nContent-Disposition: \
+form-data; name=\"ov_file\"; filename=\"%s\"\r\nContent-Type: image/bmp\r\n\r\n"
+
+#define MULTIPART_END "\r\n--" MULTIPART_BOUNDARY "--\r\n"
+
+#define SET_BASE "{ \"apiVersion\": \"1.0\", \"context\": \"123\",\"method\": \
+\"addImage\",\"params\": {\"camera\": %d,\"overlayPath\": \"/etc/overlays/%s\",\
+\"position\": %s,\"zIndex\": %d }}"
 
 // Q3617 X value 0.91
 
-#define REMOVE_BASE  "curl --anyauth -H \"Content-Type: application/json\" \
---data \"{ \\\"apiVersion\\\": \\\"1.0\\\", \\\"context\\\": \\\"123\\\",\\\"me\
-thod\\\": \\\"remove\\\",\\\"params\\\": {\\\"identity\\\": %d}}\" http://127.0\
-.0.1/axis-cgi/dynamicoverlay/dynamicoverlay.cgi --user %s:%s > \
-/tmp/curl.txt 2> /dev/null"
+#define POSITION_BASE "[%s, %s]"
+
+/* Y position outside the visible -1..1 range, used to hide an overlay */
+#define POSITION_PARKED_Y -3.0
+
+#define MOVE_BASE "{ \"apiVersion\": \"1.0\", \"context\": \"123\",\"method\": \
+\"setImage\",\"params\": {\"identity\": %d,\"position\": %s }}"
+
+#define LIST_BASE "{ \"apiVersion\": \"1.0\", \"context\": \"123\",\"method\": \
+\"list\",\"params\": {}}"
+
+#define REMOVE_BASE "{ \"apiVersion\": \"1.0\", \"context\": \"123\",\"method\"\
+: \"remove\",\"params\": {\"identity\": %d}}"
 
-#define WIPER_BASE "curl --anyauth -H \"Content-Type: application/json\" \
---data \"{ \\\"apiVersion\\\": \\\"1.0\\\", \\\"context\\\": \\\"123\\\",\\\"me\
-thod\\\": \\\"start\\\",\\\"params\\\": {\\\"id\\\": 0, \\\"duration\\\": 30}}\" http://127.0\
-.0.1/axis-cgi/clearviewcontrol.cgi --user %s:%s"
+/* Length in seconds of one clearview cycle */
+#define WIPER_DURATION 30
 
-// > \
-///tmp/curl.txt 2> /dev/null""
+#define WIPER_BASE "{ \"apiVersion\": \"1.0\", \"context\": \"123\",\"method\": \
+\"start\",\"params\": {\"id\": 0, \"duration\": %d}}"
 
-#endif // INCLUSION_GUARD_OVERLAY_COMMANDS_H
\ No newline at end of file
+#endif // INCLUSION_GUARD_OVERLAY_COMMANDS_H
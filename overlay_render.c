@@ -0,0 +1,174 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "overlay_asset.h"
+#include "overlay_render.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   { syslog(LOG_INFO, fmt, ## args); \
+    g_message(fmt, ## args); }
+
+/**
+ * Width in pixels of the black outline
+ */
+#define OUTLINE             2
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Shape names used in parameters and overlay names
+ */
+static const char *shape_names[] = {
+    [INDICATOR_RECT]   = "rect",
+    [INDICATOR_CIRCLE] = "circle",
+};
+
+/**
+ * Rendered images by overlay name
+ */
+static GHashTable *renderings = NULL;
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Classify a pixel as outside (0), outline (1) or fill (2)
+ */
+static int classify(IndicatorShape shape, guint width, guint height,
+    guint x, guint y);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Classify a pixel as outside (0), outline (1) or fill (2)
+ */
+static int classify(IndicatorShape shape, guint width, guint height,
+    guint x, guint y)
+{
+    double rx, ry, dx, dy, ix, iy;
+
+    if (shape == INDICATOR_RECT) {
+        if (x < OUTLINE || y < OUTLINE || x >= width - OUTLINE ||
+            y >= height - OUTLINE) {
+            return 1;
+        }
+
+        return 2;
+    }
+
+    /* Ellipse inscribed in the image, the outline is a smaller one inside */
+    rx = width / 2.0;
+    ry = height / 2.0;
+    dx = x + 0.5 - rx;
+    dy = y + 0.5 - ry;
+
+    if ((dx * dx) / (rx * rx) + (dy * dy) / (ry * ry) > 1.0) {
+        return 0;
+    }
+
+    ix = MAX(rx - OUTLINE, 0.5);
+    iy = MAX(ry - OUTLINE, 0.5);
+
+    if ((dx * dx) / (ix * ix) + (dy * dy) / (iy * iy) > 1.0) {
+        return 1;
+    }
+
+    return 2;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Look up a shape by its name ("rect" or "circle"), returns FALSE if unknown
+ */
+gboolean overlay_render_shape(const char *name, IndicatorShape *shape)
+{
+    gsize i;
+
+    for (i = 0; i < G_N_ELEMENTS(shape_names); i++) {
+        if (g_strcmp0(name, shape_names[i]) == 0) {
+            *shape = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Render an indicator as a 24-bit BMP, cached per parameter set
+ */
+GBytes *overlay_render(IndicatorShape shape, guint width, guint height,
+    guint32 rgb)
+{
+    gchar *name = overlay_render_name(shape, width, height, rgb);
+    guint8 colors[3][3] = {
+        { 0xff, 0xff, 0xff },
+        { 0x00, 0x00, 0x00 },
+        { rgb & 0xff, (rgb >> 8) & 0xff, (rgb >> 16) & 0xff },
+    };
+    GBytes *image;
+    guint8 *bmp;
+    gsize stride;
+    gsize size;
+    guint x, y;
+
+    if (!renderings) {
+        renderings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            (GDestroyNotify) g_bytes_unref);
+    }
+
+    image = g_hash_table_lookup(renderings, name);
+
+    if (image) {
+        g_free(name);
+        return g_bytes_ref(image);
+    }
+
+    bmp = overlay_asset_bmp_new(width, height, &stride, &size);
+
+    for (y = 0; y < height; y++) {
+        guint8 *row = bmp + OVERLAY_BMP_HEADER + y * stride;
+
+        for (x = 0; x < width; x++) {
+            memcpy(row + x * 3, colors[classify(shape, width, height, x, y)],
+                3);
+        }
+    }
+
+    LOG("Rendered indicator %s", name);
+
+    image = g_bytes_new_take(bmp, size);
+    g_hash_table_insert(renderings, name, g_bytes_ref(image));
+
+    return image;
+}
+
+/**
+ * Overlay name without suffix for a parameter set, free with g_free()
+ */
+gchar *overlay_render_name(IndicatorShape shape, guint width, guint height,
+    guint32 rgb)
+{
+    return g_strdup_printf(OVERLAY_RENDER_PREFIX "%s_%ux%u_%06x",
+        shape_names[shape], width, height, rgb & 0xffffff);
+}
+
+/**
+ * Drop all cached renderings
+ */
+void overlay_render_cleanup()
+{
+    if (renderings) {
+        g_hash_table_destroy(renderings);
+        renderings = NULL;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef INCLUSION_GUARD_OVERLAY_RENDER_H
+#define INCLUSION_GUARD_OVERLAY_RENDER_H
+
+/**
+ * Start of the names of all rendered indicators
+ */
+#define OVERLAY_RENDER_PREFIX "indicator_"
+
+/**
+ * Shapes the indicator renderer can draw
+ */
+typedef enum {
+    INDICATOR_RECT,
+    INDICATOR_CIRCLE
+} IndicatorShape;
+
+/**
+ * Look up a shape by its name ("rect" or "circle"), returns FALSE if unknown
+ */
+gboolean overlay_render_shape(const char *name, IndicatorShape *shape);
+
+/**
+ * Render an indicator as a 24-bit BMP, filled with the RGB color and
+ * outlined in black on a white (transparent) background. Results are
+ * cached per parameter set, release the returned reference with
+ * g_bytes_unref().
+ */
+GBytes *overlay_render(IndicatorShape shape, guint width, guint height,
+    guint32 rgb);
+
+/**
+ * Overlay name without suffix for a parameter set, free with g_free()
+ */
+gchar *overlay_render_name(IndicatorShape shape, guint width, guint height,
+    guint32 rgb);
+
+/**
+ * Drop all cached renderings
+ */
+void overlay_render_cleanup();
+
+#endif // INCLUSION_GUARD_OVERLAY_RENDER_H
@@ -8,8 +8,12 @@
 #include <stdlib.h>
 
 #include "cJSON.h"
+#include "asset_cache.h"
+#include "overlay_asset.h"
+#include "overlay_render.h"
 #include "overlays.h"
 #include "overlay_commands.h"
+#include "vapix.h"
 
 /******************** MACRO DEFINITION SECTION ********************************/
 
@@ -25,34 +29,215 @@
 #define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
     g_warning(fmt, ## args); }
 
+/**
+ * Most channels or view areas the overlays can be shown on
+ */
+#define MAX_CHANNELS        8
+
+/**
+ * Pack a channel index and overlay state into command user_data
+ */
+#define TAG(index, state)   GINT_TO_POINTER((index) << 2 | (state))
+
+/**
+ * Channel index from command user_data
+ */
+#define TAG_INDEX(tag)      (GPOINTER_TO_INT(tag) >> 2)
+
+/**
+ * Overlay state from command user_data
+ */
+#define TAG_STATE(tag)      ((OverlayState) (GPOINTER_TO_INT(tag) & 3))
+
+/**
+ * Delay in milliseconds before a failed batch is retried, doubled for each
+ * further failure up to RETRY_MAX
+ */
+#define RETRY_MIN           1000
+
+/**
+ * Upper bound in milliseconds of the delay before a retry
+ */
+#define RETRY_MAX           60000
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Overlay shown in the image
+ */
+typedef enum {
+    OVERLAY_NONE,
+    OVERLAY_GREEN,
+    OVERLAY_RED
+} OverlayState;
+
+/**
+ * Camera channel or view area showing the overlays, with their placement
+ * and what has been applied on it
+ */
+typedef struct {
+    int camera;
+    gdouble x;
+    gdouble y;
+    int z_index;
+    OverlayState applied;
+    int applied_identity;
+    guint applied_generation;
+    int preload_identity[3];
+    gboolean preload_shown[3];
+    guint preload_generation[3];
+} OverlayChannel;
+
+/**
+ * Asset being uploaded, kept until the upload completes
+ */
+typedef struct {
+    gchar *ovl_name;
+    gchar *hash;
+} OverlayUpload;
+
 /******************** LOCAL VARIABLE DECLARATION SECTION **********************/
 
 /**
-* Current identity of the green overlay
-*/
-static int green_identity = -1;
+ * Overlay file names of the shipped assets per state
+ */
+static const char *asset_names[] = {
+    [OVERLAY_NONE]  = NULL,
+    [OVERLAY_GREEN] = "green_quarter.ovl",
+    [OVERLAY_RED]   = "red_quarter.ovl",
+};
 
 /**
-* Current identity of the red overlay
-*/
-static int red_identity   = -1;
+ * Overlay file and log name per state, shipped or rendered
+ */
+static const char *overlay_names[] = {
+    [OVERLAY_NONE]  = NULL,
+    [OVERLAY_GREEN] = "green_quarter.ovl",
+    [OVERLAY_RED]   = "red_quarter.ovl",
+};
 
 /**
- * Username for overlay commands
+ * Overlay file names of rendered indicators per state, NULL when unused
  */
-static char *username = NULL;
+static gchar *rendered_names[] = { NULL, NULL, NULL };
 
 /**
- * Password for overlay commands
+ * Shape of rendered indicators
  */
-static char *password = NULL;
+static IndicatorShape indicator_shape = INDICATOR_RECT;
+
+/**
+ * Width of rendered indicators in pixels
+ */
+static guint indicator_width = 0;
+
+/**
+ * Height of rendered indicators in pixels
+ */
+static guint indicator_height = 0;
+
+/**
+ * RGB color of rendered indicators per state
+ */
+static guint32 indicator_colors[] = { 0, 0, 0 };
+
+/**
+ * Bumped whenever overlay_names change, overlays of older ones are replaced
+ */
+static guint generation = 0;
+
+/**
+ * Generation of the 'addImage' commands in flight
+ */
+static guint issued_generation = 0;
+
+/**
+ * State the overlays should end up in, newer requests overwrite it
+ */
+static OverlayState desired = OVERLAY_NONE;
+
+/**
+ * Channels, the ones from n_channels on only have overlays taken down
+ */
+static OverlayChannel channels[MAX_CHANNELS] = {
+    [0 ... MAX_CHANNELS - 1] = {
+        .camera = 1,
+        .x = 0.66,
+        .y = -1.0,
+        .z_index = 1,
+        .applied = OVERLAY_NONE,
+        .applied_identity = -1,
+        .preload_identity = { -1, -1, -1 },
+    },
+};
+
+/**
+ * Number of channels in use
+ */
+static guint n_channels = 1;
+
+/**
+ * Commands of the current batch still in flight
+ */
+static guint pending = 0;
+
+/**
+ * TRUE if a command of the current batch failed
+ */
+static gboolean batch_failed = FALSE;
+
+/**
+ * Timer retrying after a failed batch or listing, 0 if none
+ */
+static guint retry_source = 0;
+
+/**
+ * Delay in milliseconds of the last retry, 0 after a successful batch
+ */
+static guint retry_delay = 0;
+
+/**
+ * Uploads in flight, overlays are not added until they are done
+ */
+static guint uploading = 0;
+
+/**
+ * Number of requested states that were superseded before being applied
+ */
+static guint coalesced = 0;
+
+/**
+ * TRUE to keep both overlays added and switch by moving them
+ */
+static gboolean preload = FALSE;
+
+/**
+ * TRUE once the overlays present at startup have been adopted or removed
+ */
+static gboolean discovered = FALSE;
+
+/**
+ * TRUE once credentials are known and commands can be sent
+ */
+static gboolean initialized = FALSE;
+
+/**
+ * TRUE while the 'list' command of adopt_existing_overlays() is in flight
+ */
+static gboolean listing = FALSE;
+
+/**
+ * TRUE if the overlays are to be listed once the batch in flight is done
+ */
+static gboolean adopt_deferred = FALSE;
 
 /******************** LOCAL FUNCTION DECLARATION SECTION **********************/
 
 /**
-* Read JSON response from temporary file
-*/
-static char *get_json_buffer();
+ * Queue a JSON command for the dynamic overlay API
+ */
+static void overlay_command(const char *body, VapixCallback callback,
+    gpointer user_data);
 
 /**
 * Parse overlay identity from JSON response to 'addImage' command
@@ -60,34 +245,136 @@ static char *get_json_buffer();
 static int get_ovl_identity(const char *json_string);
 
 /**
- * Upload overlay from ACAPs folder.
+ * Request a new overlay state and start reconciling towards it
  */
-static void upload_overlay(const char *path);
+static void set_desired(OverlayState state);
 
-/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+/**
+ * Issue the next command on every channel that needs one, as one batch
+ */
+static void reconcile();
 
 /**
-* Read JSON response from temporary file
-*/
-static char *get_json_buffer()
-{
-    char *buffer = 0;
-    long length;
-    FILE *f = fopen ("/tmp/curl.txt", "rb");
-
-    if (f) {
-        fseek (f, 0, SEEK_END);
-        length = ftell (f);
-        fseek (f, 0, SEEK_SET);
-        buffer = malloc (length);
-        if (buffer) {
-            fread (buffer, 1, length, f);
-        }
-    }
+ * Queue the next command for one channel, returns FALSE if none was needed
+ */
+static gboolean reconcile_channel(guint index);
+
+/**
+ * Count one finished command of the batch, starting the next when done
+ */
+static void batch_done(gboolean ok);
+
+/**
+ * Try again later, waiting longer after each failure in a row
+ */
+static void schedule_retry();
+
+/**
+ * Timer callback retrying the listing or the reconcile that failed
+ */
+static gboolean retry(gpointer user_data);
+
+/**
+ * Format the position of a channel, shown or parked outside the image
+ */
+static void channel_position(const OverlayChannel *ch, gboolean shown,
+    gchar *buf, gsize size);
+
+/**
+ * Completion of a reconcile 'remove' command, user_data is a TAG()
+ */
+static void reconcile_removed(int status, const char *response,
+    gpointer user_data);
+
+/**
+ * Completion of a reconcile 'addImage' command, user_data is a TAG()
+ */
+static void reconcile_added(int status, const char *response,
+    gpointer user_data);
+
+/**
+ * Preload mode step of reconcile_channel(), FALSE if nothing was needed
+ */
+static gboolean reconcile_preload(guint index);
+
+/**
+ * Completion of a preload 'addImage' command, user_data is a TAG()
+ */
+static void preload_added(int status, const char *response,
+    gpointer user_data);
+
+/**
+ * Completion of a preload 'setImage' command, user_data is a TAG()
+ */
+static void preload_moved(int status, const char *response,
+    gpointer user_data);
 
-    fclose(f);
+/**
+ * Completion of a preload 'remove' command, user_data is a TAG()
+ */
+static void preload_removed(int status, const char *response,
+    gpointer user_data);
+
+/**
+ * File name of an overlay path from the 'list' command if the overlay can
+ * be ours, NULL if it belongs to someone else
+ */
+static const char *owned_name(const char *path);
+
+/**
+ * Map an overlay file name to the state it currently shows
+ */
+static OverlayState state_from_name(const char *name);
+
+/**
+ * TRUE if an overlay identity is already applied or preloaded on a channel
+ */
+static gboolean is_tracked(int identity);
+
+/**
+ * Adopt one listed overlay if it fits a channel, returns FALSE if not
+ */
+static gboolean adopt_overlay(guint index, OverlayState state, int identity,
+    const cJSON *item);
+
+/**
+ * Completion of the 'list' command sent by adopt_existing_overlays()
+ */
+static void overlays_listed(int status, const char *response,
+    gpointer user_data);
+
+/**
+ * Completion of an upload, records the asset in the cache on success
+ */
+static void overlay_uploaded(int status, const char *response,
+    gpointer user_data);
+
+/**
+ * Upload a BMP image held in memory as a multipart form
+ */
+static void upload_overlay_image(const char *filename, GBytes *image,
+    OverlayUpload *upload);
+
+/**
+ * Upload overlay from ACAPs folder, name is the file name without suffix
+ */
+static void upload_overlay(const char *name);
+
+/**
+ * Render and upload the configured indicator for a state
+ */
+static void upload_rendered(OverlayState state);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
 
-    return buffer;
+/**
+ * Queue a JSON command for the dynamic overlay API
+ */
+static void overlay_command(const char *body, VapixCallback callback,
+    gpointer user_data)
+{
+    vapix_post_async(VAPIX_OVERLAY, OVERLAY_CGI, JSON_TYPE, body,
+        strlen(body), callback != NULL, callback, user_data);
 }
 
 /**
@@ -124,15 +411,693 @@ static int get_ovl_identity(const char *json_string)
 }
 
 /**
- * Upload overlay from ACAPs folder.
+ * Request a new overlay state and start reconciling towards it
+ */
+static void set_desired(OverlayState state)
+{
+    if (state == desired) {
+        return;
+    }
+
+    /* A target that was never reached is simply replaced */
+    if (pending || desired != channels[0].applied) {
+        coalesced++;
+    }
+
+    desired = state;
+
+    reconcile();
+}
+
+/**
+ * Issue the next command on every channel that needs one, as one batch
+ */
+static void reconcile()
+{
+    guint index;
+
+    /* Nothing is sent before the overlays already there are known */
+    if (!initialized || !discovered || pending || uploading) {
+        return;
+    }
+
+    /* Trying now supersedes a scheduled retry */
+    if (retry_source) {
+        g_source_remove(retry_source);
+        retry_source = 0;
+    }
+
+    batch_failed = FALSE;
+    issued_generation = generation;
+
+    /* Queued back to back so the channels are updated in parallel */
+    for (index = 0; index < MAX_CHANNELS; index++) {
+        if (reconcile_channel(index)) {
+            pending++;
+        }
+    }
+
+    if (pending > 1) {
+        LOG("Updating overlays on %u channels", pending);
+    }
+}
+
+/**
+ * Queue the next command for one channel, returns FALSE if none was needed
+ */
+static gboolean reconcile_channel(guint index)
+{
+    OverlayChannel *ch = &channels[index];
+    gboolean enabled = index < n_channels;
+    OverlayState target = enabled ? desired : OVERLAY_NONE;
+    OverlayState state;
+    gchar position[64];
+    gchar *cmd;
+
+    if (preload && enabled) {
+        if (ch->applied == OVERLAY_NONE) {
+            return reconcile_preload(index);
+        }
+    } else {
+        /* Take down overlays left from preload mode first */
+        for (state = OVERLAY_GREEN; state <= OVERLAY_RED; state++) {
+            if (ch->preload_identity[state] >= 0) {
+                cmd = g_strdup_printf(REMOVE_BASE,
+                    ch->preload_identity[state]);
+                overlay_command(cmd, preload_removed, TAG(index, state));
+                g_free(cmd);
+
+                return TRUE;
+            }
+        }
+
+        if (target == ch->applied && (target == OVERLAY_NONE ||
+            ch->applied_generation == generation)) {
+            return FALSE;
+        }
+    }
+
+    if (ch->applied != OVERLAY_NONE) {
+        LOG("Removing %s with identity %d from camera %d",
+            overlay_names[ch->applied], ch->applied_identity, ch->camera);
+
+        cmd = g_strdup_printf(REMOVE_BASE, ch->applied_identity);
+        overlay_command(cmd, reconcile_removed, TAG(index, ch->applied));
+    } else {
+        LOG("Adding %s to camera %d (%u superseded requests so far)",
+            overlay_names[target], ch->camera, coalesced);
+
+        channel_position(ch, TRUE, position, sizeof(position));
+        cmd = g_strdup_printf(SET_BASE, ch->camera, overlay_names[target],
+            position, ch->z_index);
+        overlay_command(cmd, reconcile_added, TAG(index, target));
+    }
+
+    g_free(cmd);
+
+    return TRUE;
+}
+
+/**
+ * Count one finished command of the batch, starting the next when done
+ */
+static void batch_done(gboolean ok)
+{
+    if (!ok) {
+        batch_failed = TRUE;
+    }
+
+    if (--pending > 0) {
+        return;
+    }
+
+    if (adopt_deferred) {
+        /* The listing reconciles once it is done */
+        adopt_deferred = FALSE;
+        adopt_existing_overlays();
+    } else if (batch_failed) {
+        schedule_retry();
+    } else {
+        retry_delay = 0;
+        reconcile();
+    }
+}
+
+/**
+ * Try again later, waiting longer after each failure in a row
+ */
+static void schedule_retry()
+{
+    if (retry_source) {
+        return;
+    }
+
+    retry_delay = retry_delay ? MIN(retry_delay * 2, RETRY_MAX) : RETRY_MIN;
+
+    LOG("Retrying overlays in %u ms", retry_delay);
+
+    retry_source = g_timeout_add(retry_delay, retry, NULL);
+}
+
+/**
+ * Timer callback retrying the listing or the reconcile that failed
+ */
+static gboolean retry(gpointer user_data)
+{
+    (void) user_data;
+
+    retry_source = 0;
+
+    if (discovered) {
+        reconcile();
+    } else {
+        adopt_existing_overlays();
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Format the position of a channel, shown or parked outside the image
+ */
+static void channel_position(const OverlayChannel *ch, gboolean shown,
+    gchar *buf, gsize size)
+{
+    gchar x[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar y[G_ASCII_DTOSTR_BUF_SIZE];
+
+    /* Locale independent, JSON needs a decimal point */
+    g_ascii_dtostr(x, sizeof(x), ch->x);
+    g_ascii_dtostr(y, sizeof(y), shown ? ch->y : POSITION_PARKED_Y);
+
+    g_snprintf(buf, size, POSITION_BASE, x, y);
+}
+
+/**
+ * Completion of a reconcile 'remove' command, user_data is a TAG()
+ */
+static void reconcile_removed(int status, const char *response,
+    gpointer user_data)
+{
+    OverlayChannel *ch = &channels[TAG_INDEX(user_data)];
+
+    if (status == VAPIX_CANCELLED) {
+        return;
+    }
+
+    if (status != 200) {
+        ERR("Remove of identity %d returned %d", ch->applied_identity,
+            status);
+    }
+
+    /* Either it is gone now or it was not there to begin with */
+    ch->applied = OVERLAY_NONE;
+    ch->applied_identity = -1;
+
+    batch_done(TRUE);
+}
+
+/**
+ * Completion of a reconcile 'addImage' command, user_data is a TAG()
+ */
+static void reconcile_added(int status, const char *response,
+    gpointer user_data)
+{
+    OverlayChannel *ch = &channels[TAG_INDEX(user_data)];
+    OverlayState state = TAG_STATE(user_data);
+    int identity;
+
+    if (status == VAPIX_CANCELLED) {
+        return;
+    }
+
+    identity = response ? get_ovl_identity(response) : -1;
+
+    if (identity < 0) {
+        ERR("Failed to add %s to camera %d, status %d",
+            overlay_names[state], ch->camera, status);
+        batch_done(FALSE);
+        return;
+    }
+
+    ch->applied = state;
+    ch->applied_identity = identity;
+    ch->applied_generation = issued_generation;
+
+    LOG("Got %s identity %d on camera %d", overlay_names[state], identity,
+        ch->camera);
+
+    batch_done(TRUE);
+}
+
+/**
+ * Preload mode step of reconcile_channel(), FALSE if nothing was needed
  */
-static void upload_overlay(const char *path)
+static gboolean reconcile_preload(guint index)
 {
-    char *cmd = g_strdup_printf(UPLOAD_BASE, path, username, password);
+    OverlayChannel *ch = &channels[index];
+    OverlayState state;
+    gchar position[64];
+    gchar *cmd = NULL;
+
+    /* Red is stacked above green, so green may stay shown under it */
+    gboolean wanted[] = {
+        [OVERLAY_NONE]  = FALSE,
+        [OVERLAY_GREEN] = desired != OVERLAY_NONE,
+        [OVERLAY_RED]   = desired == OVERLAY_RED,
+    };
+
+    for (state = OVERLAY_GREEN; state <= OVERLAY_RED && !cmd; state++) {
+        channel_position(ch, wanted[state], position, sizeof(position));
+
+        if (ch->preload_identity[state] >= 0 &&
+            ch->preload_generation[state] != generation) {
+            /* Made from an older overlay name or placement, replace it */
+            cmd = g_strdup_printf(REMOVE_BASE, ch->preload_identity[state]);
+            overlay_command(cmd, preload_removed, TAG(index, state));
+        } else if (ch->preload_identity[state] < 0) {
+            LOG("Preloading %s on camera %d", overlay_names[state],
+                ch->camera);
+
+            ch->preload_shown[state] = wanted[state];
+            cmd = g_strdup_printf(SET_BASE, ch->camera, overlay_names[state],
+                position, ch->z_index + (int) state - OVERLAY_GREEN);
+            overlay_command(cmd, preload_added, TAG(index, state));
+        } else if (ch->preload_shown[state] != wanted[state]) {
+            LOG("Moving %s with identity %d to %s", overlay_names[state],
+                ch->preload_identity[state], position);
+
+            ch->preload_shown[state] = wanted[state];
+            cmd = g_strdup_printf(MOVE_BASE, ch->preload_identity[state],
+                position);
+            overlay_command(cmd, preload_moved, TAG(index, state));
+        }
+    }
 
-    system(cmd);
+    if (!cmd) {
+        return FALSE;
+    }
 
     g_free(cmd);
+
+    return TRUE;
+}
+
+/**
+ * Completion of a preload 'addImage' command, user_data is a TAG()
+ */
+static void preload_added(int status, const char *response,
+    gpointer user_data)
+{
+    OverlayChannel *ch = &channels[TAG_INDEX(user_data)];
+    OverlayState state = TAG_STATE(user_data);
+    int identity;
+
+    if (status == VAPIX_CANCELLED) {
+        return;
+    }
+
+    identity = response ? get_ovl_identity(response) : -1;
+
+    if (identity < 0) {
+        ERR("Failed to preload %s on camera %d, status %d",
+            overlay_names[state], ch->camera, status);
+        batch_done(FALSE);
+        return;
+    }
+
+    ch->preload_identity[state] = identity;
+    ch->preload_generation[state] = issued_generation;
+
+    LOG("Got preloaded %s identity %d on camera %d", overlay_names[state],
+        identity, ch->camera);
+
+    batch_done(TRUE);
+}
+
+/**
+ * Completion of a preload 'setImage' command, user_data is a TAG()
+ */
+static void preload_moved(int status, const char *response,
+    gpointer user_data)
+{
+    OverlayChannel *ch = &channels[TAG_INDEX(user_data)];
+    OverlayState state = TAG_STATE(user_data);
+
+    if (status == VAPIX_CANCELLED) {
+        return;
+    }
+
+    if (status != 200) {
+        /* Unknown position now, make the next reconcile move it again */
+        ERR("Failed to move %s, status %d", overlay_names[state], status);
+        ch->preload_shown[state] = !ch->preload_shown[state];
+        batch_done(FALSE);
+        return;
+    }
+
+    batch_done(TRUE);
+}
+
+/**
+ * Completion of a preload 'remove' command, user_data is a TAG()
+ */
+static void preload_removed(int status, const char *response,
+    gpointer user_data)
+{
+    OverlayChannel *ch = &channels[TAG_INDEX(user_data)];
+    OverlayState state = TAG_STATE(user_data);
+
+    if (status == VAPIX_CANCELLED) {
+        return;
+    }
+
+    if (status != 200) {
+        ERR("Remove of identity %d returned %d", ch->preload_identity[state],
+            status);
+    }
+
+    ch->preload_identity[state] = -1;
+    ch->preload_shown[state] = FALSE;
+
+    batch_done(TRUE);
+}
+
+/**
+ * File name of an overlay path from the 'list' command if the overlay can
+ * be ours, NULL if it belongs to someone else
+ */
+static const char *owned_name(const char *path)
+{
+    const char *name;
+    OverlayState state;
+
+    if (!path || !g_str_has_prefix(path, OVERLAY_DIR "/")) {
+        return NULL;
+    }
+
+    name = path + strlen(OVERLAY_DIR "/");
+
+    /* Rendered with any settings, also ones that are no longer in use */
+    if (g_str_has_prefix(name, OVERLAY_RENDER_PREFIX) &&
+        g_str_has_suffix(name, ".ovl")) {
+        return name;
+    }
+
+    for (state = OVERLAY_GREEN; state <= OVERLAY_RED; state++) {
+        if (g_strcmp0(name, asset_names[state]) == 0) {
+            return name;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Map an overlay file name to the state it currently shows
+ */
+static OverlayState state_from_name(const char *name)
+{
+    OverlayState state;
+
+    for (state = OVERLAY_GREEN; state <= OVERLAY_RED; state++) {
+        if (name && g_strcmp0(name, overlay_names[state]) == 0) {
+            return state;
+        }
+    }
+
+    return OVERLAY_NONE;
+}
+
+/**
+ * TRUE if an overlay identity is already applied or preloaded on a channel
+ */
+static gboolean is_tracked(int identity)
+{
+    OverlayState state;
+    guint index;
+
+    for (index = 0; index < MAX_CHANNELS; index++) {
+        if (channels[index].applied_identity == identity) {
+            return TRUE;
+        }
+
+        for (state = OVERLAY_GREEN; state <= OVERLAY_RED; state++) {
+            if (channels[index].preload_identity[state] == identity) {
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Adopt one listed overlay if it fits a channel, returns FALSE if not
+ */
+static gboolean adopt_overlay(guint index, OverlayState state, int identity,
+    const cJSON *item)
+{
+    OverlayChannel *ch = &channels[index];
+    const cJSON *camera = cJSON_GetObjectItemCaseSensitive(item, "camera");
+
+    if (cJSON_IsNumber(camera) && camera->valueint != ch->camera) {
+        return FALSE;
+    }
+
+    if (preload) {
+        const cJSON *position = cJSON_GetObjectItemCaseSensitive(item,
+            "position");
+        const cJSON *y = cJSON_GetArrayItem(position, 1);
+        const cJSON *z = cJSON_GetObjectItemCaseSensitive(item, "zIndex");
+
+        /* Stacking only works with the zIndex preloading uses */
+        if (ch->preload_identity[state] >= 0 || (cJSON_IsNumber(z) &&
+            z->valueint != ch->z_index + (int) state - OVERLAY_GREEN)) {
+            return FALSE;
+        }
+
+        ch->preload_identity[state] = identity;
+        ch->preload_shown[state] = !cJSON_IsNumber(y) ||
+            y->valuedouble >= -1.0;
+        ch->preload_generation[state] = generation;
+    } else {
+        if (ch->applied != OVERLAY_NONE) {
+            return FALSE;
+        }
+
+        ch->applied = state;
+        ch->applied_identity = identity;
+        ch->applied_generation = generation;
+    }
+
+    LOG("Adopted %s with identity %d on camera %d", overlay_names[state],
+        identity, ch->camera);
+
+    return TRUE;
+}
+
+/**
+ * Completion of the 'list' command sent by adopt_existing_overlays()
+ */
+static void overlays_listed(int status, const char *response,
+    gpointer user_data)
+{
+    cJSON *root = response ? cJSON_Parse(response) : NULL;
+    cJSON *data = cJSON_GetObjectItemCaseSensitive(root, "data");
+    cJSON *images = cJSON_GetObjectItemCaseSensitive(data, "imageOverlays");
+    cJSON *item;
+
+    (void) user_data;
+
+    if (status == VAPIX_CANCELLED) {
+        return;
+    }
+
+    listing = FALSE;
+    pending--;
+
+    if (!cJSON_IsArray(images)) {
+        ERR("Failed to list dynamic overlays, status %d", status);
+        cJSON_Delete(root);
+        schedule_retry();
+        return;
+    }
+
+    discovered = TRUE;
+    retry_delay = 0;
+
+    cJSON_ArrayForEach(item, images) {
+        const cJSON *identity = cJSON_GetObjectItemCaseSensitive(item,
+            "identity");
+        const cJSON *path = cJSON_GetObjectItemCaseSensitive(item,
+            "overlayPath");
+        const char *name = owned_name(cJSON_IsString(path) ?
+            path->valuestring : NULL);
+        OverlayState state = state_from_name(name);
+        guint index = 0;
+
+        /* Leave overlays that belong to someone else alone */
+        if (!name || !cJSON_IsNumber(identity) ||
+            is_tracked(identity->valueint)) {
+            continue;
+        }
+
+        /* Overlays of other images, such as an earlier indicator, go */
+        if (state != OVERLAY_NONE) {
+            for (index = 0; index < n_channels; index++) {
+                if (adopt_overlay(index, state, identity->valueint, item)) {
+                    break;
+                }
+            }
+        }
+
+        if (state == OVERLAY_NONE || index == n_channels) {
+            gchar *cmd = g_strdup_printf(REMOVE_BASE, identity->valueint);
+
+            LOG("Removing leftover %s with identity: %d", name,
+                identity->valueint);
+
+            overlay_command(cmd, NULL, NULL);
+            g_free(cmd);
+        }
+    }
+
+    cJSON_Delete(root);
+
+    reconcile();
+}
+
+/**
+ * Completion of an upload, records the asset in the cache on success
+ */
+static void overlay_uploaded(int status, const char *response,
+    gpointer user_data)
+{
+    OverlayUpload *upload = user_data;
+
+    if (status == 200) {
+        LOG("Uploaded %s", upload->ovl_name);
+        asset_cache_store(upload->ovl_name, upload->hash);
+    } else if (status != VAPIX_CANCELLED) {
+        ERR("Failed to upload %s, status %d", upload->ovl_name, status);
+    }
+
+    g_free(upload->ovl_name);
+    g_free(upload->hash);
+    g_free(upload);
+
+    if (status == VAPIX_CANCELLED) {
+        return;
+    }
+
+    if (--uploading == 0) {
+        reconcile();
+    }
+}
+
+/**
+ * Upload a BMP image held in memory as a multipart form
+ */
+static void upload_overlay_image(const char *filename, GBytes *image,
+    OverlayUpload *upload)
+{
+    static const char *fields[][2] = {
+        { "usetransparent", "true" },
+        { "colorcode", "FFFFFF" },
+        { "usescalable", "true" },
+        { "type", "fullcolor" },
+    };
+    gsize length;
+    gconstpointer data = g_bytes_get_data(image, &length);
+    GString *body = g_string_sized_new(length + 1024);
+    gsize i;
+
+    for (i = 0; i < G_N_ELEMENTS(fields); i++) {
+        g_string_append_printf(body, MULTIPART_FIELD, fields[i][0],
+            fields[i][1]);
+    }
+
+    g_string_append_printf(body, MULTIPART_FILE, filename);
+    g_string_append_len(body, data, length);
+    g_string_append(body, MULTIPART_END);
+
+    uploading++;
+
+    vapix_post_async(VAPIX_UPLOAD, UPLOAD_CGI, MULTIPART_TYPE, body->str,
+        body->len, FALSE, overlay_uploaded, upload);
+
+    g_string_free(body, TRUE);
+}
+
+/**
+ * Upload overlay from ACAPs folder, name is the file name without suffix
+ */
+static void upload_overlay(const char *name)
+{
+    gchar *file = g_strdup_printf("%s/%s.orle", PACKAGE_DIR, name);
+    gchar *bmp_name = g_strconcat(name, ".bmp", NULL);
+    OverlayUpload *upload = g_new0(OverlayUpload, 1);
+    GBytes *image;
+
+    upload->ovl_name = g_strconcat(name, ".ovl", NULL);
+
+    /* The compact asset is expanded only for as long as the upload */
+    image = overlay_asset_load(file, &upload->hash);
+
+    if (!image) {
+        ERR("Failed to load overlay asset %s", file);
+
+        g_free(upload->ovl_name);
+        g_free(upload);
+    } else if (asset_cache_is_current(upload->ovl_name, upload->hash)) {
+        LOG("Overlay %s is up to date, skipping upload", upload->ovl_name);
+
+        g_free(upload->ovl_name);
+        g_free(upload->hash);
+        g_free(upload);
+    } else {
+        upload_overlay_image(bmp_name, image, upload);
+    }
+
+    if (image) {
+        g_bytes_unref(image);
+    }
+
+    g_free(file);
+    g_free(bmp_name);
+}
+
+/**
+ * Render and upload the configured indicator for a state
+ */
+static void upload_rendered(OverlayState state)
+{
+    GBytes *image = overlay_render(indicator_shape, indicator_width,
+        indicator_height, indicator_colors[state]);
+    gchar *name = overlay_render_name(indicator_shape, indicator_width,
+        indicator_height, indicator_colors[state]);
+    gchar *bmp_name = g_strconcat(name, ".bmp", NULL);
+    OverlayUpload *upload = g_new0(OverlayUpload, 1);
+    gsize length;
+    gconstpointer data = g_bytes_get_data(image, &length);
+
+    upload->ovl_name = g_strconcat(name, ".ovl", NULL);
+    upload->hash = asset_cache_hash(data, length);
+
+    if (asset_cache_is_current(upload->ovl_name, upload->hash)) {
+        LOG("Overlay %s is up to date, skipping upload", upload->ovl_name);
+
+        g_free(upload->ovl_name);
+        g_free(upload->hash);
+        g_free(upload);
+    } else {
+        upload_overlay_image(bmp_name, image, upload);
+    }
+
+    g_bytes_unref(image);
+    g_free(bmp_name);
+    g_free(name);
 }
 
 /******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
@@ -142,11 +1107,17 @@ static void upload_overlay(const char *path)
  */
 void init_overlays(const char *user, const char *pass, gboolean red)
 {
-    g_free(username);
-    g_free(password);
+    vapix_init(user, pass);
+
+    initialized = TRUE;
 
-    username = g_strdup(user);
-    password = g_strdup(pass);
+    /* Only assets that changed since they were last uploaded are sent */
+    asset_cache_init(ASSET_CACHE);
+    upload_overlays();
+
+    if (!discovered) {
+        adopt_existing_overlays();
+    }
 }
 
 /**
@@ -154,110 +1125,212 @@ void init_overlays(const char *user, const char *pass, gboolean red)
  */
 void cleanup_overlays()
 {
-    g_free(username);
-    g_free(password);
+    OverlayState state;
+
+    if (retry_source) {
+        g_source_remove(retry_source);
+        retry_source = 0;
+    }
+
+    vapix_cleanup();
+    asset_cache_cleanup();
+    overlay_render_cleanup();
+
+    for (state = OVERLAY_GREEN; state <= OVERLAY_RED; state++) {
+        g_free(rendered_names[state]);
+        rendered_names[state] = NULL;
+    }
 
     /* Purposely leaving the uploaded overlay images behind. */
 }
 
 /**
-* Remove the red overlay from the image.
-*/
-void remove_red()
+ * Select how overlay states are switched
+ */
+void set_overlay_preload(gboolean enable)
 {
-    LOG("Removing red with identity: %d", red_identity);
-
-    if (red_identity > 0) {
-        gchar *cmd = g_strdup_printf(REMOVE_BASE, red_identity, username,
-            password);
-        system(cmd);
-        g_free(cmd);
+    if (enable == preload) {
+        return;
     }
 
-    red_identity = -1;
+    LOG("Overlay preload mode %s", enable ? "enabled" : "disabled");
+
+    preload = enable;
+
+    reconcile();
 }
 
 /**
-* Remove the green overlay from the image.
-*/
-void remove_green()
+ * Select the channels or view areas the overlays are shown on
+ */
+gboolean set_overlay_channels(const char *spec)
 {
-    LOG("Removing green with identity: %d", green_identity);
+    OverlayChannel parsed[MAX_CHANNELS];
+    gchar **entries = g_strsplit(spec ? spec : "", ";", -1);
+    guint count = g_strv_length(entries);
+    guint index;
+
+    if (count == 0 || count > MAX_CHANNELS) {
+        ERR("Invalid overlay channels '%s', expected 1 to %d entries",
+            spec, MAX_CHANNELS);
+        g_strfreev(entries);
+        return FALSE;
+    }
+
+    for (index = 0; index < count; index++) {
+        gchar **fields = g_strsplit(g_strstrip(entries[index]), ":", -1);
+        gchar **coords = fields[0] && fields[1] ?
+            g_strsplit(fields[1], ",", -1) : NULL;
+        gboolean ok = coords && g_strv_length(coords) == 2 &&
+            g_strv_length(fields) <= 3;
+
+        if (ok) {
+            parsed[index].camera = atoi(fields[0]);
+            parsed[index].x = g_ascii_strtod(coords[0], NULL);
+            parsed[index].y = g_ascii_strtod(coords[1], NULL);
+            parsed[index].z_index = fields[2] ? atoi(fields[2]) : 1;
+            ok = parsed[index].camera > 0;
+        }
 
-    if (green_identity > 0) {
-        gchar *cmd = g_strdup_printf(REMOVE_BASE, green_identity, username,
-            password);
-        system(cmd);
-        g_free(cmd);
+        g_strfreev(coords);
+        g_strfreev(fields);
+
+        if (!ok) {
+            ERR("Invalid overlay channel '%s', expected "
+                "<camera>:<x>,<y>[:<zIndex>]", entries[index]);
+            g_strfreev(entries);
+            return FALSE;
+        }
+    }
+
+    g_strfreev(entries);
+
+    for (index = 0; index < count; index++) {
+        channels[index].camera = parsed[index].camera;
+        channels[index].x = parsed[index].x;
+        channels[index].y = parsed[index].y;
+        channels[index].z_index = parsed[index].z_index;
+    }
+
+    n_channels = count;
+
+    /* Overlays placed with the old settings are replaced */
+    generation++;
+
+    LOG("Showing overlays on %u channels", n_channels);
+
+    if (initialized) {
+        reconcile();
     }
 
-    green_identity = -1;
+    return TRUE;
 }
 
 /**
-* Set the red overlay as active
-*/
-int set_red()
+ * Select the overlay images, shipped assets or rendered indicators
+ */
+gboolean set_overlay_indicator(const char *spec)
 {
-    int ret = -1;
+    gchar **fields = NULL;
+    IndicatorShape shape = INDICATOR_RECT;
+    guint width = 0;
+    guint height = 0;
+    guint32 colors[] = { 0, 0, 0 };
+    OverlayState state;
+    gboolean enable = spec && *spec && g_strcmp0(spec, "asset") != 0;
+
+    if (enable) {
+        fields = g_strsplit(spec, ",", -1);
+
+        if (g_strv_length(fields) != 4 ||
+            !overlay_render_shape(fields[0], &shape) ||
+            sscanf(fields[1], "%ux%u", &width, &height) != 2 ||
+            width == 0 || width > 1024 || height == 0 || height > 1024) {
+            ERR("Invalid indicator '%s', expected "
+                "<rect|circle>,<width>x<height>,<alarm RRGGBB>,<clear RRGGBB>",
+                spec);
+            g_strfreev(fields);
+            return FALSE;
+        }
 
-    if (red_identity >= 0) {
-        return 0;
+        colors[OVERLAY_RED]   = g_ascii_strtoull(fields[2], NULL, 16);
+        colors[OVERLAY_GREEN] = g_ascii_strtoull(fields[3], NULL, 16);
+
+        g_strfreev(fields);
     }
 
-    if (green_identity >= 0) {
-        remove_green();
+    for (state = OVERLAY_GREEN; state <= OVERLAY_RED; state++) {
+        g_free(rendered_names[state]);
+        rendered_names[state] = NULL;
+
+        if (enable) {
+            gchar *name = overlay_render_name(shape, width, height,
+                colors[state]);
+
+            rendered_names[state] = g_strconcat(name, ".ovl", NULL);
+            g_free(name);
+        }
+
+        overlay_names[state] = enable ? rendered_names[state] :
+            asset_names[state];
     }
 
-    char *cmd = g_strdup_printf(SET_BASE, "red_quarter.ovl", username,
-        password);
+    indicator_shape = shape;
+    indicator_width = width;
+    indicator_height = height;
+    memcpy(indicator_colors, colors, sizeof(indicator_colors));
 
-    system(cmd);
-    g_free(cmd);
+    generation++;
 
-    char *buffer = get_json_buffer();
+    LOG("Using overlays %s and %s", overlay_names[OVERLAY_GREEN],
+        overlay_names[OVERLAY_RED]);
 
-    if (buffer) {
-        red_identity = get_ovl_identity(buffer);
-        LOG("Got Red identity: %d", red_identity);
-        free(buffer);
-        ret = 0;
+    if (initialized) {
+        upload_overlays();
+        reconcile();
     }
 
-    return ret;
+    return TRUE;
 }
 
 /**
-* Set the green overlay as active
+* Remove the red overlay from the image.
 */
-int set_green()
+void remove_red()
 {
-    int ret = -1;
-
-    if (green_identity >= 0) {
-        return 0;
+    if (desired == OVERLAY_RED) {
+        set_desired(OVERLAY_NONE);
     }
+}
 
-    if (red_identity >= 0) {
-        remove_red();
+/**
+* Remove the green overlay from the image.
+*/
+void remove_green()
+{
+    if (desired == OVERLAY_GREEN) {
+        set_desired(OVERLAY_NONE);
     }
+}
 
-    char *cmd = g_strdup_printf(SET_BASE, "green_quarter.ovl", username,
-        password);
-
-    system(cmd);
-    g_free(cmd);
+/**
+* Set the red overlay as active
+*/
+int set_red()
+{
+    set_desired(OVERLAY_RED);
 
-    char *buffer = get_json_buffer();
+    return 0;
+}
 
-    if (buffer) {
-        green_identity = get_ovl_identity(buffer);
-        LOG("Got Green identity: %d", green_identity);
-        free(buffer);
-        ret = 0;
-    }
+/**
+* Set the green overlay as active
+*/
+int set_green()
+{
+    set_desired(OVERLAY_GREEN);
 
-    return ret;
+    return 0;
 }
 
 /**
@@ -265,43 +1338,48 @@ int set_green()
 */
 void upload_overlays()
 {
-    upload_overlay("green_quarter.bmp");
-    upload_overlay("red_quarter.bmp");
+    if (rendered_names[OVERLAY_GREEN]) {
+        upload_rendered(OVERLAY_GREEN);
+        upload_rendered(OVERLAY_RED);
+    } else {
+        upload_overlay("green_quarter");
+        upload_overlay("red_quarter");
+    }
 }
 
 /**
-* Remove existing dynamic overlays
+* Adopt our dynamic overlays left from a previous run, remove duplicates
 */
-void remove_existing_overlays()
+void adopt_existing_overlays()
 {
-    size_t i = 1;
-    gchar *cmd;
+    /* The listing in flight will do */
+    if (listing) {
+        return;
+    }
 
-    for (; i <= 6; i++) {
-        cmd = g_strdup_printf(REMOVE_BASE, i, username, password);
-        system(cmd);
-        g_free(cmd);
+    /* Listed once the batch in flight is done, so the list is current */
+    if (pending) {
+        adopt_deferred = TRUE;
+        return;
     }
 
-    red_identity = green_identity = -1;
+    listing = TRUE;
+    pending++;
+
+    overlay_command(LIST_BASE, overlays_listed, NULL);
 }
 
 /**
-* Run wiper for 30 seconds
+* Run wiper for 30 seconds, callback gets the result of the request
 */
-void run_wiper()
+void run_wiper(VapixCallback callback, gpointer user_data)
 {
-    int ret = -1;
-
-    char *cmd = g_strdup_printf(WIPER_BASE, username,
-        password);
+    gchar *cmd = g_strdup_printf(WIPER_BASE, WIPER_DURATION);
 
     LOG("Complete command %s", cmd);
 
-    system(cmd);
+    vapix_post_async(VAPIX_WIPER, WIPER_CGI, JSON_TYPE, cmd, strlen(cmd),
+        FALSE, callback, user_data);
+
     g_free(cmd);
 }
-
-
-
-
@@ -1,6 +1,8 @@
 #ifndef INCLUSION_GUARD_OVERLAYS_H
 #define INCLUSION_GUARD_OVERLAYS_H
 
+#include "vapix.h"
+
 /**
  * Initialize overlays
  */
@@ -11,6 +13,27 @@ void init_overlays(const char *username, const char *password, gboolean red);
  */
 void cleanup_overlays();
 
+/**
+ * Select how overlay states are switched. When enabled both overlays are
+ * added once and a state change only moves the red one in or out of view,
+ * otherwise every change removes one overlay and adds the other.
+ */
+void set_overlay_preload(gboolean enable);
+
+/**
+ * Select the channels or view areas the overlays are shown on, as
+ * "<camera>:<x>,<y>[:<zIndex>]" entries separated by ';'. A state change is
+ * applied to all of them at once. Returns FALSE if spec is invalid.
+ */
+gboolean set_overlay_channels(const char *spec);
+
+/**
+ * Select the overlay images. "asset" (or empty) uses the shipped bitmaps,
+ * "<rect|circle>,<width>x<height>,<alarm RRGGBB>,<clear RRGGBB>" renders
+ * indicators in memory instead. Returns FALSE if spec is invalid.
+ */
+gboolean set_overlay_indicator(const char *spec);
+
 /**
 * Remove the red overlay from the image.
 */
@@ -22,12 +45,12 @@ void remove_red();
 void remove_green();
 
 /**
-* Set the red overlay as active
+* Set the red overlay as active, the change is applied asynchronously
 */
 int set_red();
 
 /**
-* Set the green overlay as active
+* Set the green overlay as active, the change is applied asynchronously
 */
 int set_green();
 
@@ -37,14 +60,14 @@ int set_green();
 void upload_overlays();
 
 /**
-* Remove existing dynamic overlays
+* Adopt our dynamic overlays left from a previous run, remove duplicates
 */
-void remove_existing_overlays();
+void adopt_existing_overlays();
 
 /**
- * Run wiper for 30 seconds
+ * Run wiper for 30 seconds, callback gets the result of the request
  */
-void run_wiper();
+void run_wiper(VapixCallback callback, gpointer user_data);
 
 
 #endif // INCLUSION_GUARD_OVERLAYS_H
\ No newline at end of file
@@ -0,0 +1,446 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "timer_wheel.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Slots per level as a power of two
+ */
+#define SLOT_BITS           6
+
+/**
+ * Slots per level
+ */
+#define SLOTS               (1 << SLOT_BITS)
+
+/**
+ * Mask for the slot index within a level
+ */
+#define SLOT_MASK           (SLOTS - 1)
+
+/**
+ * Number of levels, each slot of a level spans a whole turn of the one below
+ */
+#define LEVELS              4
+
+/**
+ * Ticks covered by all levels, about 46 hours. Later expiries are parked in
+ * the last slot and placed again when they are cascaded.
+ */
+#define WHEEL_SPAN          ((guint64) 1 << (SLOT_BITS * LEVELS))
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Doubly linked list node, a list head is a node linked to itself
+ */
+typedef struct TimerLink {
+    struct TimerLink *next;
+    struct TimerLink *prev;
+} TimerLink;
+
+/**
+ * Timer on the shared wheel, link must be the first member
+ */
+struct TimerWheelTimer {
+    TimerLink link;
+    guint64 expires;
+    TimerWheelCallback callback;
+    gpointer user_data;
+};
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Timer lists by level and slot
+ */
+static TimerLink slots[LEVELS][SLOTS];
+
+/**
+ * TRUE once the slot lists are initialized
+ */
+static gboolean initialized = FALSE;
+
+/**
+ * Monotonic time in microseconds of tick 0
+ */
+static gint64 epoch = 0;
+
+/**
+ * Next tick to process
+ */
+static guint64 wheel_tick = 0;
+
+/**
+ * Main loop timeout driving the wheel, 0 while no timer is pending
+ */
+static guint tick_source = 0;
+
+/**
+ * Tick the timeout is armed for
+ */
+static guint64 armed_tick = 0;
+
+/**
+ * Number of pending timers
+ */
+static guint pending = 0;
+
+/**
+ * Number of timers that expired
+ */
+static guint fired = 0;
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Make a list head empty
+ */
+static void link_init(TimerLink *head);
+
+/**
+ * Unlink a node from its list
+ */
+static void link_remove(TimerLink *link);
+
+/**
+ * Move all nodes of list from to the empty list to
+ */
+static void link_move(TimerLink *from, TimerLink *to);
+
+/**
+ * Current tick by the monotonic clock
+ */
+static guint64 clock_tick();
+
+/**
+ * Put a timer in the slot for its expiry relative to wheel_tick
+ */
+static void place(TimerWheelTimer *timer);
+
+/**
+ * Process one tick, cascading higher levels and firing expired timers
+ */
+static void run_tick();
+
+/**
+ * First tick at or after wheel_tick that fires or cascades a timer
+ */
+static guint64 next_tick();
+
+/**
+ * Arm the main loop timeout for a tick unless it is armed for an earlier one
+ */
+static void arm(guint64 tick);
+
+/**
+ * Main loop timeout catching the wheel up with the clock
+ */
+static gboolean on_tick(gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Make a list head empty
+ */
+static void link_init(TimerLink *head)
+{
+    head->next = head;
+    head->prev = head;
+}
+
+/**
+ * Unlink a node from its list
+ */
+static void link_remove(TimerLink *link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = NULL;
+    link->prev = NULL;
+}
+
+/**
+ * Move all nodes of list from to the empty list to
+ */
+static void link_move(TimerLink *from, TimerLink *to)
+{
+    if (from->next == from) {
+        return;
+    }
+
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+
+    link_init(from);
+}
+
+/**
+ * Current tick by the monotonic clock
+ */
+static guint64 clock_tick()
+{
+    return (g_get_monotonic_time() - epoch) / (TIMER_WHEEL_TICK * 1000);
+}
+
+/**
+ * Put a timer in the slot for its expiry relative to wheel_tick
+ */
+static void place(TimerWheelTimer *timer)
+{
+    guint64 expires = MAX(timer->expires, wheel_tick);
+    guint64 delta;
+    guint level = 0;
+    TimerLink *head;
+
+    if (expires - wheel_tick >= WHEEL_SPAN) {
+        expires = wheel_tick + WHEEL_SPAN - 1;
+    }
+
+    delta = expires - wheel_tick;
+
+    while (level < LEVELS - 1 &&
+        delta >= (guint64) 1 << (SLOT_BITS * (level + 1))) {
+        level++;
+    }
+
+    head = &slots[level][(expires >> (SLOT_BITS * level)) & SLOT_MASK];
+
+    /* Append so timers of one tick fire in the order they were started */
+    timer->link.next = head;
+    timer->link.prev = head->prev;
+    head->prev->next = &timer->link;
+    head->prev = &timer->link;
+}
+
+/**
+ * Process one tick, cascading higher levels and firing expired timers
+ */
+static void run_tick()
+{
+    guint64 tick = wheel_tick;
+    TimerLink expired;
+    guint level;
+
+    link_init(&expired);
+
+    /* At the start of each turn of a level, spread the next slot above */
+    for (level = 1; level < LEVELS; level++) {
+        guint index = (tick >> (SLOT_BITS * (level - 1))) & SLOT_MASK;
+        TimerLink cascade;
+
+        if (index != 0) {
+            break;
+        }
+
+        link_init(&cascade);
+        link_move(&slots[level][(tick >> (SLOT_BITS * level)) & SLOT_MASK],
+            &cascade);
+
+        while (cascade.next != &cascade) {
+            TimerWheelTimer *timer = (TimerWheelTimer *) cascade.next;
+
+            link_remove(&timer->link);
+            place(timer);
+        }
+    }
+
+    /* Timers started by the callbacks below belong to later ticks */
+    wheel_tick = tick + 1;
+    link_move(&slots[0][tick & SLOT_MASK], &expired);
+
+    while (expired.next != &expired) {
+        TimerWheelTimer *timer = (TimerWheelTimer *) expired.next;
+
+        link_remove(&timer->link);
+        pending--;
+        fired++;
+
+        timer->callback(timer->user_data);
+    }
+}
+
+/**
+ * First tick at or after wheel_tick that fires or cascades a timer
+ */
+static guint64 next_tick()
+{
+    guint64 next = G_MAXUINT64;
+    guint level;
+    guint offset;
+
+    for (level = 0; level < LEVELS; level++) {
+        guint shift = SLOT_BITS * level;
+        /* Slots of a level are visited on its first tick, in order */
+        guint64 base = (wheel_tick + ((guint64) 1 << shift) - 1) >> shift;
+
+        for (offset = 0; offset < SLOTS; offset++) {
+            TimerLink *head = &slots[level][(base + offset) & SLOT_MASK];
+
+            if (head->next != head) {
+                next = MIN(next, (base + offset) << shift);
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
+/**
+ * Arm the main loop timeout for a tick unless it is armed for an earlier one
+ */
+static void arm(guint64 tick)
+{
+    gint64 delay;
+
+    if (tick_source) {
+        if (armed_tick <= tick) {
+            return;
+        }
+
+        g_source_remove(tick_source);
+    }
+
+    delay = epoch + (gint64) tick * TIMER_WHEEL_TICK * 1000 -
+        g_get_monotonic_time();
+
+    armed_tick = tick;
+    tick_source = g_timeout_add(delay > 0 ? (delay + 999) / 1000 : 0,
+        on_tick, NULL);
+}
+
+/**
+ * Main loop timeout catching the wheel up with the clock
+ */
+static gboolean on_tick(gpointer user_data)
+{
+    guint64 now = clock_tick();
+    guint64 next;
+
+    (void) user_data;
+
+    /* Timers started by the callbacks arm a new timeout */
+    tick_source = 0;
+
+    /* Only the ticks that fire or cascade timers are run */
+    while (pending > 0 && (next = next_tick()) <= now) {
+        wheel_tick = next;
+        run_tick();
+    }
+
+    if (pending > 0) {
+        wheel_tick = MAX(wheel_tick, now + 1);
+        arm(next_tick());
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Create a stopped timer
+ */
+TimerWheelTimer *timer_wheel_timer_new(TimerWheelCallback callback,
+    gpointer user_data)
+{
+    TimerWheelTimer *timer = g_new0(TimerWheelTimer, 1);
+
+    timer->callback = callback;
+    timer->user_data = user_data;
+
+    return timer;
+}
+
+/**
+ * Stop and free a timer
+ */
+void timer_wheel_timer_free(TimerWheelTimer *timer)
+{
+    if (timer) {
+        timer_wheel_cancel(timer);
+        g_free(timer);
+    }
+}
+
+/**
+ * (Re)start a timer to expire after at least delay milliseconds, within a
+ * tick after that.
+ */
+void timer_wheel_start(TimerWheelTimer *timer, guint delay)
+{
+    guint i;
+
+    if (!initialized) {
+        for (i = 0; i < LEVELS * SLOTS; i++) {
+            link_init(&slots[i / SLOTS][i % SLOTS]);
+        }
+
+        epoch = g_get_monotonic_time();
+        initialized = TRUE;
+    }
+
+    timer_wheel_cancel(timer);
+
+    /* An idle wheel skips ahead instead of walking the empty ticks */
+    if (pending == 0) {
+        wheel_tick = MAX(wheel_tick, clock_tick());
+    }
+
+    /* First tick boundary at or after the due time, so never fire early */
+    timer->expires = (g_get_monotonic_time() - epoch + (gint64) delay * 1000 +
+        TIMER_WHEEL_TICK * 1000 - 1) / (TIMER_WHEEL_TICK * 1000);
+    place(timer);
+    pending++;
+
+    arm(timer->expires);
+}
+
+/**
+ * Stop a timer if it is pending.
+ */
+void timer_wheel_cancel(TimerWheelTimer *timer)
+{
+    if (timer->link.next) {
+        link_remove(&timer->link);
+        pending--;
+    }
+}
+
+/**
+ * TRUE if the timer is started and has not expired yet
+ */
+gboolean timer_wheel_pending(const TimerWheelTimer *timer)
+{
+    return timer->link.next != NULL;
+}
+
+/**
+ * Write the number of pending timers as an XML element
+ */
+void timer_wheel_report(GString *xml)
+{
+    g_string_append_printf(xml, "<timers pending='%u' fired='%u' "
+        "tick='%d'/>", pending, fired, TIMER_WHEEL_TICK);
+}
+
+/**
+ * Remove the main loop timeout, pending timers never fire
+ */
+void timer_wheel_cleanup()
+{
+    if (tick_source) {
+        g_source_remove(tick_source);
+        tick_source = 0;
+    }
+}
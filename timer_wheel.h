@@ -0,0 +1,57 @@
+#ifndef INCLUSION_GUARD_TIMER_WHEEL_H
+#define INCLUSION_GUARD_TIMER_WHEEL_H
+
+/**
+ * Resolution of wheel timers in milliseconds
+ */
+#define TIMER_WHEEL_TICK 10
+
+/**
+ * Called from the main loop when a timer expires
+ */
+typedef void (*TimerWheelCallback)(gpointer user_data);
+
+/**
+ * Timer on the shared wheel, all timers run off a single main loop timeout
+ * that is armed for the next tick with a timer to fire or cascade
+ */
+typedef struct TimerWheelTimer TimerWheelTimer;
+
+/**
+ * Create a stopped timer
+ */
+TimerWheelTimer *timer_wheel_timer_new(TimerWheelCallback callback,
+    gpointer user_data);
+
+/**
+ * Stop and free a timer
+ */
+void timer_wheel_timer_free(TimerWheelTimer *timer);
+
+/**
+ * (Re)start a timer to expire after at least delay milliseconds, within a
+ * tick after that. Constant time.
+ */
+void timer_wheel_start(TimerWheelTimer *timer, guint delay);
+
+/**
+ * Stop a timer if it is pending. Constant time.
+ */
+void timer_wheel_cancel(TimerWheelTimer *timer);
+
+/**
+ * TRUE if the timer is started and has not expired yet
+ */
+gboolean timer_wheel_pending(const TimerWheelTimer *timer);
+
+/**
+ * Write the number of pending timers as an XML element
+ */
+void timer_wheel_report(GString *xml);
+
+/**
+ * Remove the main loop timeout, pending timers never fire
+ */
+void timer_wheel_cleanup();
+
+#endif // INCLUSION_GUARD_TIMER_WHEEL_H
@@ -0,0 +1,184 @@
+/**
+ * Build-time converter from 24-bit BMP to the compact overlay format read
+ * by overlay_asset.c. See overlay_asset.h for the file layout.
+ *
+ * Usage: bmp2orle <input.bmp> <output.orle>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Largest palette the format can describe
+ */
+#define MAX_COLORS          255
+
+/**
+ * Longest run stored in one run record
+ */
+#define MAX_RUN             255
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Read a little endian value of size bytes
+ */
+static unsigned long get_le(const unsigned char *p, int size);
+
+/**
+ * Write a 16-bit little endian value
+ */
+static void put_le16(FILE *f, unsigned int value);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Read a little endian value of size bytes
+ */
+static unsigned long get_le(const unsigned char *p, int size)
+{
+    unsigned long value = 0;
+
+    while (size--) {
+        value = (value << 8) | p[size];
+    }
+
+    return value;
+}
+
+/**
+ * Write a 16-bit little endian value
+ */
+static void put_le16(FILE *f, unsigned int value)
+{
+    fputc(value & 0xff, f);
+    fputc((value >> 8) & 0xff, f);
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Main entry point for the converter
+ */
+int main(int argc, char *argv[])
+{
+    static unsigned char palette[MAX_COLORS][3];
+    unsigned char header[54];
+    unsigned char *pixels = NULL;
+    unsigned long offset, width, height, stride, x, y;
+    unsigned int colors = 0, run = 0, index = 0, prev = 0;
+    FILE *in = NULL, *out = NULL;
+    int ret = 1;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <input.bmp> <output.orle>\n", argv[0]);
+        return 1;
+    }
+
+    in = fopen(argv[1], "rb");
+
+    if (!in || fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        memcmp(header, "BM", 2) != 0) {
+        fprintf(stderr, "%s: not a BMP file\n", argv[1]);
+        goto out;
+    }
+
+    offset = get_le(header + 10, 4);
+    width  = get_le(header + 18, 4);
+    height = get_le(header + 22, 4);
+
+    if (get_le(header + 28, 2) != 24 || get_le(header + 30, 4) != 0 ||
+        width == 0 || width > 0xffff || height == 0 || height > 0xffff) {
+        fprintf(stderr, "%s: only bottom-up uncompressed 24-bit BMP is "
+            "supported\n", argv[1]);
+        goto out;
+    }
+
+    stride = (width * 3 + 3) & ~3UL;
+    pixels = malloc(stride * height);
+
+    if (!pixels || fseek(in, offset, SEEK_SET) != 0 ||
+        fread(pixels, 1, stride * height, in) != stride * height) {
+        fprintf(stderr, "%s: truncated pixel data\n", argv[1]);
+        goto out;
+    }
+
+    /* First pass collects the palette */
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            const unsigned char *p = pixels + y * stride + x * 3;
+
+            for (index = 0; index < colors; index++) {
+                if (memcmp(palette[index], p, 3) == 0) {
+                    break;
+                }
+            }
+
+            if (index == colors) {
+                if (colors == MAX_COLORS) {
+                    fprintf(stderr, "%s: more than %d colors\n", argv[1],
+                        MAX_COLORS);
+                    goto out;
+                }
+
+                memcpy(palette[colors++], p, 3);
+            }
+        }
+    }
+
+    out = fopen(argv[2], "wb");
+
+    if (!out) {
+        fprintf(stderr, "%s: cannot create\n", argv[2]);
+        goto out;
+    }
+
+    fwrite("ORLE", 1, 4, out);
+    put_le16(out, width);
+    put_le16(out, height);
+    fputc(colors, out);
+    fwrite(palette, 3, colors, out);
+
+    /* Second pass writes (length, index) runs in BMP row order */
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            const unsigned char *p = pixels + y * stride + x * 3;
+
+            for (index = 0; memcmp(palette[index], p, 3) != 0; index++) {
+            }
+
+            if (run > 0 && (index != prev || run == MAX_RUN)) {
+                fputc(run, out);
+                fputc(prev, out);
+                run = 0;
+            }
+
+            prev = index;
+            run++;
+        }
+    }
+
+    fputc(run, out);
+    fputc(prev, out);
+
+    ret = ferror(out) ? 1 : 0;
+
+out:
+    if (in) {
+        fclose(in);
+    }
+
+    if (out && fclose(out) != 0) {
+        ret = 1;
+    }
+
+    if (ret != 0 && out) {
+        remove(argv[2]);
+    }
+
+    free(pixels);
+
+    return ret;
+}
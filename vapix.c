@@ -0,0 +1,1541 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <gio/gio.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "vapix.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   { syslog(LOG_INFO, fmt, ## args); \
+    g_message(fmt, ## args); }
+
+/**
+ * Error message macro
+ */
+#define ERR(fmt, args...)   { syslog(LOG_ERR, fmt, ## args); \
+    g_warning(fmt, ## args); }
+
+/**
+ * Address of the local web server
+ */
+#ifndef VAPIX_HOST
+#define VAPIX_HOST          "127.0.0.1"
+#endif
+
+/**
+ * Port of the local web server
+ */
+#ifndef VAPIX_PORT
+#define VAPIX_PORT          80
+#endif
+
+/**
+ * Timeout in seconds for connecting, reading and writing
+ */
+#define VAPIX_TIMEOUT       10
+
+/**
+ * Size of the receive buffer for the persistent connection
+ */
+#define VAPIX_RECV_SIZE     4096
+
+/**
+ * Longest status or header line that is accepted from the server
+ */
+#define VAPIX_MAX_LINE      4096
+
+/**
+ * Attempts made for a request that failed before the server processed it
+ */
+#define VAPIX_ATTEMPTS      4
+
+/**
+ * Backoff in milliseconds before the first retry, doubled for each one
+ */
+#define VAPIX_BACKOFF_BASE  250
+
+/**
+ * Upper bound in milliseconds of the backoff between retries
+ */
+#define VAPIX_BACKOFF_MAX   4000
+
+/**
+ * Largest request body kept in a pooled request, larger ones are freed
+ */
+#define VAPIX_POOL_BODY_MAX 65536
+
+/**
+ * Consecutive failures that open the circuit breaker
+ */
+#define BREAKER_THRESHOLD   5
+
+/**
+ * Seconds the breaker stays open before requests are tried again
+ */
+#define BREAKER_OPEN_TIME   15
+
+/******************** LOCAL TYPE DEFINITION SECTION ***************************/
+
+/**
+ * Persistent connection to the web server with its receive buffer
+ */
+typedef struct {
+    GSocketClient *client;
+    GSocketConnection *conn;
+    GInputStream *in;
+    GOutputStream *out;
+    gchar buf[VAPIX_RECV_SIZE];
+    gsize pos;
+    gsize end;
+    gsize received;
+    gboolean closed;
+    GString *line;
+    GString *request;
+    GString *authorization;
+    GChecksum *checksum;
+} VapixConnection;
+
+/**
+ * Parsed status line and the headers we act on
+ */
+typedef struct {
+    int status;
+    gboolean keep_alive;
+    gboolean chunked;
+    gssize content_length;
+    gchar *authenticate;
+    gboolean sent;
+} VapixHead;
+
+/**
+ * Last authentication challenge with what can be precomputed from it
+ */
+typedef struct {
+    gboolean valid;
+    gboolean digest;
+    gboolean qop;
+    gchar *realm;
+    gchar *nonce;
+    gchar *opaque;
+    gchar *ha1;
+    gchar *basic;
+    guint nc;
+} VapixAuth;
+
+/**
+ * Worker pool and bounded queue for one class of requests
+ */
+typedef struct {
+    const char *name;
+    gint max_running;
+    guint max_queued;
+    gboolean critical;
+    GThreadPool *pool;
+    gint running;
+    guint peak;
+    guint completed;
+    guint rejected;
+    gint retried;
+    gint shed;
+} VapixQueue;
+
+/**
+ * Queued asynchronous request and its result
+ */
+typedef struct {
+    VapixQueue *queue;
+    GString *path;
+    GString *content_type;
+    GString *body;
+    gboolean want_response;
+    gboolean dropped;
+    int status;
+    GString *response;
+    VapixCallback callback;
+    gpointer user_data;
+} VapixRequest;
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Worker limits per request class. Overlay commands of one batch go to
+ * different channels and may run in parallel, uploads stay in order.
+ * Requests of classes that are not critical are shed while the breaker is
+ * open.
+ */
+static VapixQueue queues[VAPIX_CLASSES] = {
+    [VAPIX_OVERLAY] = { "overlay", 4, 32, TRUE },
+    [VAPIX_UPLOAD]  = { "upload",  1, 8,  TRUE },
+    [VAPIX_WIPER]   = { "wiper",   1, 4,  FALSE },
+};
+
+/**
+ * Consecutive failed requests, also while the breaker is open
+ */
+static guint breaker_failures = 0;
+
+/**
+ * Monotonic time the breaker closes again, 0 if it is not open
+ */
+static gint64 breaker_until = 0;
+
+/**
+ * Number of times the breaker has opened
+ */
+static guint breaker_trips = 0;
+
+/**
+ * Protects the breaker state, which is updated by all workers
+ */
+static GMutex breaker_lock;
+
+/**
+ * Keep-alive connections not currently used by a request
+ */
+static GQueue idle_connections = G_QUEUE_INIT;
+
+/**
+ * Protects idle_connections
+ */
+static GMutex conn_lock;
+
+/**
+ * Protects the credentials and the cached challenge
+ */
+static GMutex auth_lock;
+
+/**
+ * Cached challenge, answered up front so requests need no 401 round-trip
+ */
+static VapixAuth auth;
+
+/**
+ * Requests the workers are done with, waiting for their callbacks
+ */
+static GQueue finished = G_QUEUE_INIT;
+
+/**
+ * Protects finished and finished_source
+ */
+static GMutex finished_lock;
+
+/**
+ * Idle source calling the callbacks of finished requests, 0 if none
+ */
+static guint finished_source = 0;
+
+/**
+ * Set by vapix_cleanup(), queued requests are then cancelled unsent
+ */
+static gint closing = FALSE;
+
+/**
+ * Response buffers not in use, recycled so responses need no allocation
+ */
+static GQueue buffer_pool = G_QUEUE_INIT;
+
+/**
+ * Requests not in use, recycled together with their string buffers
+ */
+static GQueue request_pool = G_QUEUE_INIT;
+
+/**
+ * Protects buffer_pool and request_pool, which are shared by the workers
+ * and the main loop
+ */
+static GMutex pool_lock;
+
+/**
+ * Username for VAPIX requests
+ */
+static char *username = NULL;
+
+/**
+ * Password for VAPIX requests
+ */
+static char *password = NULL;
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Take an idle connection, or a new unopened one if there is none
+ */
+static VapixConnection *conn_get();
+
+/**
+ * Return a connection to the idle list
+ */
+static void conn_put(VapixConnection *c);
+
+/**
+ * Close and free a connection
+ */
+static void conn_free(VapixConnection *c);
+
+/**
+ * Open the connection to the web server
+ */
+static gboolean conn_open(VapixConnection *c);
+
+/**
+ * Close the connection and drop any buffered data
+ */
+static void conn_close(VapixConnection *c);
+
+/**
+ * Read more data into the receive buffer
+ */
+static gboolean conn_fill(VapixConnection *c);
+
+/**
+ * Read one CRLF terminated line, without the line ending
+ */
+static gboolean conn_read_line(VapixConnection *c, GString *line);
+
+/**
+ * Read exactly length bytes, appending them to dst unless it is NULL
+ */
+static gboolean conn_read_body(VapixConnection *c, gsize length, GString *dst);
+
+/**
+ * Read status line and headers of a response
+ */
+static gboolean read_head(VapixConnection *c, VapixHead *head);
+
+/**
+ * Read the body of a response according to its headers
+ */
+static gboolean read_body(VapixConnection *c, VapixHead *head, GString *dst);
+
+/**
+ * Get a parameter value from a WWW-Authenticate challenge
+ */
+static gchar *auth_param(const char *challenge, const char *name);
+
+/**
+ * Forget the cached challenge
+ */
+static void auth_clear();
+
+/**
+ * Cache a WWW-Authenticate challenge and what can be precomputed from it
+ */
+static void auth_update(const char *challenge);
+
+/**
+ * Write the Authorization header value from the cached challenge into the
+ * connection, FALSE if there is none. Each call uses the next nonce count.
+ */
+static gboolean auth_header(VapixConnection *c, const char *method,
+    const char *path);
+
+/**
+ * Send one request and read its response on the persistent connection
+ */
+static gboolean do_request(VapixConnection *c, const char *path,
+    const char *content_type, const char *body, gsize length,
+    gboolean authorize, VapixHead *head, GString *response);
+
+/**
+ * Send a request, answering an authentication challenge if needed
+ */
+static int post_once(const char *path, const char *content_type,
+    const char *body, gsize length, GString *response, gboolean *sent);
+
+/**
+ * TRUE while the web server is considered unhealthy
+ */
+static gboolean breaker_is_open();
+
+/**
+ * Record the outcome of a request attempt in the breaker
+ */
+static void breaker_record(gboolean healthy);
+
+/**
+ * TRUE if the status means the server was too busy to handle the request
+ */
+static gboolean status_is_busy(int status);
+
+/**
+ * Sleep before retry number attempt, with jitter so workers spread out
+ */
+static void backoff(int attempt);
+
+/**
+ * Create the worker pools that are not running yet
+ */
+static void queues_init();
+
+/**
+ * Take an empty response buffer from the pool
+ */
+static GString *buffer_get();
+
+/**
+ * Return a response buffer to the pool
+ */
+static void buffer_put(GString *buffer);
+
+/**
+ * Take an empty request from the pool
+ */
+static VapixRequest *request_get();
+
+/**
+ * Return a finished request to the pool
+ */
+static void request_put(VapixRequest *req);
+
+/**
+ * Free a pooled request
+ */
+static void request_free(gpointer data);
+
+/**
+ * Worker thread function, runs one queued request
+ */
+static void request_run(gpointer data, gpointer user_data);
+
+/**
+ * Hand a finished request to the main loop, from any thread
+ */
+static void request_finish(VapixRequest *req);
+
+/**
+ * Idle callback calling the user callbacks of finished requests
+ */
+static gboolean requests_done(gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Take an idle connection, or a new unopened one if there is none
+ */
+static VapixConnection *conn_get()
+{
+    VapixConnection *c;
+
+    g_mutex_lock(&conn_lock);
+    c = g_queue_pop_head(&idle_connections);
+    g_mutex_unlock(&conn_lock);
+
+    if (!c) {
+        c = g_new0(VapixConnection, 1);
+        c->request = g_string_sized_new(1024);
+        c->line = g_string_sized_new(128);
+        c->authorization = g_string_sized_new(256);
+        c->checksum = g_checksum_new(G_CHECKSUM_MD5);
+    }
+
+    return c;
+}
+
+/**
+ * Return a connection to the idle list
+ */
+static void conn_put(VapixConnection *c)
+{
+    g_mutex_lock(&conn_lock);
+    g_queue_push_head(&idle_connections, c);
+    g_mutex_unlock(&conn_lock);
+}
+
+/**
+ * Close and free a connection
+ */
+static void conn_free(VapixConnection *c)
+{
+    conn_close(c);
+
+    if (c->client) {
+        g_object_unref(c->client);
+    }
+
+    g_string_free(c->request, TRUE);
+    g_string_free(c->line, TRUE);
+    g_string_free(c->authorization, TRUE);
+    g_checksum_free(c->checksum);
+    g_free(c);
+}
+
+/**
+ * Open the connection to the web server
+ */
+static gboolean conn_open(VapixConnection *c)
+{
+    GError *error = NULL;
+
+    /* Each connection has its own client since they are used concurrently */
+    if (!c->client) {
+        c->client = g_socket_client_new();
+        g_socket_client_set_timeout(c->client, VAPIX_TIMEOUT);
+    }
+
+    c->conn = g_socket_client_connect_to_host(c->client, VAPIX_HOST,
+        VAPIX_PORT, NULL, &error);
+
+    if (!c->conn) {
+        ERR("Failed to connect to %s: %s", VAPIX_HOST, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    c->in  = g_io_stream_get_input_stream(G_IO_STREAM(c->conn));
+    c->out = g_io_stream_get_output_stream(G_IO_STREAM(c->conn));
+    c->pos = c->end = 0;
+
+    return TRUE;
+}
+
+/**
+ * Close the connection and drop any buffered data
+ */
+static void conn_close(VapixConnection *c)
+{
+    if (c->conn) {
+        g_io_stream_close(G_IO_STREAM(c->conn), NULL, NULL);
+        g_object_unref(c->conn);
+    }
+
+    c->conn = NULL;
+    c->in = NULL;
+    c->out = NULL;
+    c->pos = c->end = 0;
+}
+
+/**
+ * Read more data into the receive buffer
+ */
+static gboolean conn_fill(VapixConnection *c)
+{
+    GError *error = NULL;
+    gssize n;
+
+    if (c->pos == c->end) {
+        c->pos = c->end = 0;
+    }
+
+    n = g_input_stream_read(c->in, c->buf + c->end,
+        sizeof(c->buf) - c->end, NULL, &error);
+
+    if (n < 0) {
+        /* Also covers a connection reset by the server */
+        c->closed = g_error_matches(error, G_IO_ERROR,
+            G_IO_ERROR_CONNECTION_CLOSED);
+
+        ERR("Failed to read from %s: %s", VAPIX_HOST, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    c->end += n;
+    c->received += n;
+    c->closed = n == 0;
+
+    return n > 0;
+}
+
+/**
+ * Read one CRLF terminated line, without the line ending
+ */
+static gboolean conn_read_line(VapixConnection *c, GString *line)
+{
+    g_string_truncate(line, 0);
+
+    for (;;) {
+        gchar *start = c->buf + c->pos;
+        gchar *nl = memchr(start, '\n', c->end - c->pos);
+
+        if (nl) {
+            g_string_append_len(line, start, nl - start);
+            c->pos += nl - start + 1;
+
+            if (line->len > 0 && line->str[line->len - 1] == '\r') {
+                g_string_truncate(line, line->len - 1);
+            }
+
+            return TRUE;
+        }
+
+        g_string_append_len(line, start, c->end - c->pos);
+        c->pos = c->end;
+
+        if (line->len > VAPIX_MAX_LINE || !conn_fill(c)) {
+            return FALSE;
+        }
+    }
+}
+
+/**
+ * Read exactly length bytes, appending them to dst unless it is NULL
+ */
+static gboolean conn_read_body(VapixConnection *c, gsize length, GString *dst)
+{
+    GError *error = NULL;
+    gsize n = MIN(length, c->end - c->pos);
+
+    /* Hand over what is already buffered */
+    if (dst) {
+        g_string_append_len(dst, c->buf + c->pos, n);
+    }
+
+    c->pos += n;
+    length -= n;
+
+    if (dst && length > 0) {
+        /* Read the remainder straight into the response buffer */
+        gsize offset = dst->len;
+
+        g_string_set_size(dst, offset + length);
+
+        if (!g_input_stream_read_all(c->in, dst->str + offset, length, &n,
+            NULL, &error) || n < length) {
+            if (error) {
+                ERR("Failed to read from %s: %s", VAPIX_HOST, error->message);
+                g_error_free(error);
+            }
+
+            g_string_truncate(dst, offset + n);
+            return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    while (length > 0) {
+        if (!conn_fill(c)) {
+            return FALSE;
+        }
+
+        n = MIN(length, c->end - c->pos);
+        c->pos += n;
+        length -= n;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Read status line and headers of a response
+ */
+static gboolean read_head(VapixConnection *c, VapixHead *head)
+{
+    GString *line = c->line;
+
+    /* Skip any informational 1xx responses */
+    do {
+        if (!conn_read_line(c, line)) {
+            return FALSE;
+        }
+
+        if (!g_str_has_prefix(line->str, "HTTP/1.") || line->len < 12) {
+            ERR("Malformed status line from %s", VAPIX_HOST);
+            return FALSE;
+        }
+
+        head->status = atoi(line->str + 9);
+        head->keep_alive = line->str[7] == '1';
+        head->chunked = FALSE;
+        head->content_length = -1;
+
+        for (;;) {
+            gchar *value;
+
+            if (!conn_read_line(c, line)) {
+                return FALSE;
+            }
+
+            if (line->len == 0) {
+                break;
+            }
+
+            value = strchr(line->str, ':');
+
+            if (!value) {
+                continue;
+            }
+
+            *value++ = '\0';
+            value = g_strstrip(value);
+
+            if (g_ascii_strcasecmp(line->str, "Content-Length") == 0) {
+                head->content_length = g_ascii_strtoll(value, NULL, 10);
+            } else if (g_ascii_strcasecmp(line->str,
+                "Transfer-Encoding") == 0) {
+                head->chunked = g_ascii_strcasecmp(value, "chunked") == 0;
+            } else if (g_ascii_strcasecmp(line->str, "Connection") == 0) {
+                if (g_ascii_strcasecmp(value, "close") == 0) {
+                    head->keep_alive = FALSE;
+                } else if (g_ascii_strcasecmp(value, "keep-alive") == 0) {
+                    head->keep_alive = TRUE;
+                }
+            } else if (g_ascii_strcasecmp(line->str,
+                "WWW-Authenticate") == 0) {
+                /* Prefer Digest when the server offers several schemes */
+                if (!head->authenticate ||
+                    g_ascii_strncasecmp(value, "Digest", 6) == 0) {
+                    g_free(head->authenticate);
+                    head->authenticate = g_strdup(value);
+                }
+            }
+        }
+    } while (head->status >= 100 && head->status < 200);
+
+    return TRUE;
+}
+
+/**
+ * Read the body of a response according to its headers
+ */
+static gboolean read_body(VapixConnection *c, VapixHead *head, GString *dst)
+{
+    GString *line = c->line;
+
+    if (head->status == 204 || head->status == 304) {
+        return TRUE;
+    }
+
+    if (!head->chunked) {
+        if (head->content_length >= 0) {
+            return conn_read_body(c, head->content_length, dst);
+        }
+
+        /* No framing, the body runs until the server closes */
+        head->keep_alive = FALSE;
+
+        do {
+            if (dst) {
+                g_string_append_len(dst, c->buf + c->pos, c->end - c->pos);
+            }
+            c->pos = c->end;
+        } while (conn_fill(c));
+
+        return TRUE;
+    }
+
+    for (;;) {
+        gsize size;
+
+        if (!conn_read_line(c, line)) {
+            return FALSE;
+        }
+
+        size = g_ascii_strtoull(line->str, NULL, 16);
+
+        if (size == 0) {
+            break;
+        }
+
+        if (!conn_read_body(c, size, dst) || !conn_read_line(c, line)) {
+            return FALSE;
+        }
+    }
+
+    /* Consume trailers up to the terminating empty line */
+    do {
+        if (!conn_read_line(c, line)) {
+            return FALSE;
+        }
+    } while (line->len > 0);
+
+    return TRUE;
+}
+
+/**
+ * Get a parameter value from a WWW-Authenticate challenge
+ */
+static gchar *auth_param(const char *challenge, const char *name)
+{
+    const char *p = strchr(challenge, ' ');
+    gsize name_len = strlen(name);
+
+    while (p && *p) {
+        const char *key;
+        const char *value;
+        gsize key_len;
+        gsize value_len;
+
+        while (*p == ' ' || *p == ',') {
+            p++;
+        }
+
+        key = p;
+
+        while (*p && *p != '=' && *p != ',') {
+            p++;
+        }
+
+        key_len = p - key;
+
+        if (*p != '=') {
+            continue;
+        }
+
+        p++;
+
+        if (*p == '"') {
+            value = ++p;
+
+            while (*p && *p != '"') {
+                p++;
+            }
+
+            value_len = p - value;
+
+            if (*p) {
+                p++;
+            }
+        } else {
+            value = p;
+
+            while (*p && *p != ',' && *p != ' ') {
+                p++;
+            }
+
+            value_len = p - value;
+        }
+
+        if (key_len == name_len &&
+            g_ascii_strncasecmp(key, name, key_len) == 0) {
+            return g_strndup(value, value_len);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Forget the cached challenge
+ */
+static void auth_clear()
+{
+    g_free(auth.realm);
+    g_free(auth.nonce);
+    g_free(auth.opaque);
+    g_free(auth.ha1);
+    g_free(auth.basic);
+
+    memset(&auth, 0, sizeof(auth));
+}
+
+/**
+ * Cache a WWW-Authenticate challenge and what can be precomputed from it
+ */
+static void auth_update(const char *challenge)
+{
+    g_mutex_lock(&auth_lock);
+
+    auth_clear();
+
+    auth.valid = TRUE;
+    auth.digest = g_ascii_strncasecmp(challenge, "Digest", 6) == 0;
+
+    if (auth.digest) {
+        gchar *qop = auth_param(challenge, "qop");
+        gchar *a1;
+
+        auth.realm  = auth_param(challenge, "realm");
+        auth.nonce  = auth_param(challenge, "nonce");
+        auth.opaque = auth_param(challenge, "opaque");
+        auth.qop = qop && strstr(qop, "auth") != NULL;
+
+        if (!auth.realm) {
+            auth.realm = g_strdup("");
+        }
+
+        if (!auth.nonce) {
+            auth.nonce = g_strdup("");
+        }
+
+        /* HA1 only depends on the credentials and realm */
+        a1 = g_strdup_printf("%s:%s:%s", username, auth.realm, password);
+        auth.ha1 = g_compute_checksum_for_string(G_CHECKSUM_MD5, a1, -1);
+
+        g_free(a1);
+        g_free(qop);
+    } else {
+        gchar *plain = g_strdup_printf("%s:%s", username, password);
+
+        auth.basic = g_base64_encode((const guchar *) plain, strlen(plain));
+
+        g_free(plain);
+    }
+
+    g_mutex_unlock(&auth_lock);
+}
+
+/**
+ * Write the Authorization header value from the cached challenge into the
+ * connection, FALSE if there is none. Each call uses the next nonce count.
+ */
+static gboolean auth_header(VapixConnection *c, const char *method,
+    const char *path)
+{
+    GString *header = c->authorization;
+    GChecksum *checksum = c->checksum;
+    gboolean ret = TRUE;
+
+    g_mutex_lock(&auth_lock);
+
+    if (auth.valid && auth.digest) {
+        gchar cnonce[17];
+        gchar nc[9];
+        gchar ha2[33];
+
+        g_snprintf(cnonce, sizeof(cnonce), "%08x%08x", g_random_int(),
+            g_random_int());
+        g_snprintf(nc, sizeof(nc), "%08x", ++auth.nc);
+
+        /* Hashed piecewise on the connection's checksum, no strings built */
+        g_checksum_reset(checksum);
+        g_checksum_update(checksum, (const guchar *) method, -1);
+        g_checksum_update(checksum, (const guchar *) ":", 1);
+        g_checksum_update(checksum, (const guchar *) path, -1);
+        g_strlcpy(ha2, g_checksum_get_string(checksum), sizeof(ha2));
+
+        g_checksum_reset(checksum);
+        g_checksum_update(checksum, (const guchar *) auth.ha1, -1);
+        g_checksum_update(checksum, (const guchar *) ":", 1);
+        g_checksum_update(checksum, (const guchar *) auth.nonce, -1);
+        g_checksum_update(checksum, (const guchar *) ":", 1);
+
+        if (auth.qop) {
+            g_checksum_update(checksum, (const guchar *) nc, -1);
+            g_checksum_update(checksum, (const guchar *) ":", 1);
+            g_checksum_update(checksum, (const guchar *) cnonce, -1);
+            g_checksum_update(checksum, (const guchar *) ":auth:", 6);
+        }
+
+        g_checksum_update(checksum, (const guchar *) ha2, -1);
+
+        g_string_printf(header, "Digest username=\"%s\", realm=\"%s\", "
+            "nonce=\"%s\", uri=\"%s\", response=\"%s\", algorithm=MD5",
+            username, auth.realm, auth.nonce, path,
+            g_checksum_get_string(checksum));
+
+        if (auth.qop) {
+            g_string_append_printf(header,
+                ", qop=auth, nc=%s, cnonce=\"%s\"", nc, cnonce);
+        }
+
+        if (auth.opaque) {
+            g_string_append_printf(header, ", opaque=\"%s\"", auth.opaque);
+        }
+    } else if (auth.valid) {
+        g_string_printf(header, "Basic %s", auth.basic);
+    } else {
+        ret = FALSE;
+    }
+
+    g_mutex_unlock(&auth_lock);
+
+    return ret;
+}
+
+/**
+ * Send one request and read its response on the persistent connection
+ */
+static gboolean do_request(VapixConnection *c, const char *path,
+    const char *content_type, const char *body, gsize length,
+    gboolean authorize, VapixHead *head, GString *response)
+{
+    GString *request = c->request;
+    gboolean ret = FALSE;
+    int attempt;
+
+    head->status = 0;
+    g_free(head->authenticate);
+    head->authenticate = NULL;
+
+    g_string_printf(request,
+        "POST %s HTTP/1.1\r\n"
+        "Host: " VAPIX_HOST "\r\n"
+        "Connection: keep-alive\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %" G_GSIZE_FORMAT "\r\n",
+        path, content_type, length);
+
+    if (authorize) {
+        g_string_append(request, "Authorization: ");
+        g_string_append_len(request, c->authorization->str,
+            c->authorization->len);
+        g_string_append(request, "\r\n");
+    }
+
+    g_string_append(request, "\r\n");
+    g_string_append_len(request, body, length);
+
+    /* A reused connection may have been closed by the server while idle.
+     * Send again on a new one only if the server cannot have seen the
+     * request, other failures are left to the retry rules of the caller.
+     */
+    for (attempt = 0; attempt < 2 && !ret; attempt++) {
+        gboolean reused = c->conn != NULL;
+        gsize written = 0;
+
+        head->sent = FALSE;
+
+        if (!reused && !conn_open(c)) {
+            break;
+        }
+
+        if (!g_output_stream_write_all(c->out, request->str, request->len,
+            &written, NULL, NULL)) {
+            head->sent = written > 0;
+            conn_close(c);
+
+            if (reused && written == 0) {
+                continue;
+            }
+
+            break;
+        }
+
+        head->sent = TRUE;
+        c->received = 0;
+        c->closed = FALSE;
+
+        if (!read_head(c, head)) {
+            gboolean stale = reused && c->closed && c->received == 0;
+
+            conn_close(c);
+
+            /* Closed without a single byte of response */
+            if (stale) {
+                continue;
+            }
+
+            break;
+        }
+
+        ret = TRUE;
+    }
+
+    if (ret) {
+        if (response) {
+            g_string_truncate(response, 0);
+        }
+
+        if (!read_body(c, head, response)) {
+            ret = FALSE;
+            head->keep_alive = FALSE;
+        }
+
+        if (!head->keep_alive) {
+            conn_close(c);
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Send a request, answering an authentication challenge if needed
+ */
+static int post_once(const char *path, const char *content_type,
+    const char *body, gsize length, GString *response, gboolean *sent)
+{
+    VapixConnection *c = conn_get();
+    VapixHead head = { 0 };
+    gboolean authorize = auth_header(c, "POST", path);
+    gboolean ok;
+    int ret = -1;
+
+    ok = do_request(c, path, content_type, body, length, authorize,
+        &head, response);
+
+    /* Normally only on the first request or when the nonce has gone stale */
+    if (ok && head.status == 401 && head.authenticate) {
+        if (authorize) {
+            gchar *stale = auth_param(head.authenticate, "stale");
+
+            LOG("VAPIX %s, authenticating again",
+                g_ascii_strcasecmp(stale ? stale : "", "true") == 0 ?
+                "nonce is stale" : "credentials were rejected");
+
+            g_free(stale);
+        }
+
+        auth_update(head.authenticate);
+
+        authorize = auth_header(c, "POST", path);
+
+        ok = do_request(c, path, content_type, body, length, authorize,
+            &head, response);
+    }
+
+    if (ok) {
+        ret = head.status;
+    } else {
+        ERR("VAPIX request to %s failed", path);
+    }
+
+    if (sent) {
+        *sent = head.sent;
+    }
+
+    g_free(head.authenticate);
+
+    conn_put(c);
+
+    return ret;
+}
+
+/**
+ * TRUE while the web server is considered unhealthy
+ */
+static gboolean breaker_is_open()
+{
+    gboolean ret;
+
+    g_mutex_lock(&breaker_lock);
+    ret = breaker_until > g_get_monotonic_time();
+    g_mutex_unlock(&breaker_lock);
+
+    return ret;
+}
+
+/**
+ * Record the outcome of a request attempt in the breaker
+ */
+static void breaker_record(gboolean healthy)
+{
+    gint64 now = g_get_monotonic_time();
+
+    g_mutex_lock(&breaker_lock);
+
+    if (healthy) {
+        if (breaker_failures >= BREAKER_THRESHOLD) {
+            LOG("VAPIX circuit breaker closed");
+        }
+
+        breaker_failures = 0;
+        breaker_until = 0;
+    } else if (++breaker_failures >= BREAKER_THRESHOLD &&
+        breaker_until <= now) {
+        /* Once past the threshold, a single failed probe reopens it */
+        ERR("VAPIX circuit breaker open after %u failures",
+            breaker_failures);
+
+        breaker_until = now + (gint64) BREAKER_OPEN_TIME * G_USEC_PER_SEC;
+        breaker_trips++;
+    }
+
+    g_mutex_unlock(&breaker_lock);
+}
+
+/**
+ * TRUE if the status means the server was too busy to handle the request
+ */
+static gboolean status_is_busy(int status)
+{
+    return status == 429 || status == 503;
+}
+
+/**
+ * Sleep before retry number attempt, with jitter so workers spread out
+ */
+static void backoff(int attempt)
+{
+    gint32 delay = MIN(VAPIX_BACKOFF_MAX, VAPIX_BACKOFF_BASE << (attempt - 1));
+
+    /* Somewhere between half and all of the exponential delay */
+    delay = delay / 2 + g_random_int_range(0, delay / 2 + 1);
+
+    g_usleep((gulong) delay * 1000);
+}
+
+/**
+ * Create the worker pools that are not running yet
+ */
+static void queues_init()
+{
+    int i;
+
+    for (i = 0; i < VAPIX_CLASSES; i++) {
+        if (!queues[i].pool) {
+            queues[i].pool = g_thread_pool_new(request_run, &queues[i],
+                queues[i].max_running, FALSE, NULL);
+        }
+    }
+}
+
+/**
+ * Take an empty response buffer from the pool
+ */
+static GString *buffer_get()
+{
+    GString *buffer;
+
+    g_mutex_lock(&pool_lock);
+    buffer = g_queue_pop_head(&buffer_pool);
+    g_mutex_unlock(&pool_lock);
+
+    if (!buffer) {
+        return g_string_sized_new(VAPIX_RECV_SIZE);
+    }
+
+    return g_string_truncate(buffer, 0);
+}
+
+/**
+ * Return a response buffer to the pool
+ */
+static void buffer_put(GString *buffer)
+{
+    g_mutex_lock(&pool_lock);
+    g_queue_push_head(&buffer_pool, buffer);
+    g_mutex_unlock(&pool_lock);
+}
+
+/**
+ * Take an empty request from the pool
+ */
+static VapixRequest *request_get()
+{
+    VapixRequest *req;
+
+    g_mutex_lock(&pool_lock);
+    req = g_queue_pop_head(&request_pool);
+    g_mutex_unlock(&pool_lock);
+
+    if (!req) {
+        req = g_new0(VapixRequest, 1);
+        req->path = g_string_sized_new(64);
+        req->content_type = g_string_sized_new(64);
+        req->body = g_string_sized_new(1024);
+    }
+
+    return req;
+}
+
+/**
+ * Return a finished request to the pool
+ */
+static void request_put(VapixRequest *req)
+{
+    if (req->response) {
+        buffer_put(req->response);
+        req->response = NULL;
+    }
+
+    /* Do not keep the memory of an image upload around */
+    if (req->body->allocated_len > VAPIX_POOL_BODY_MAX) {
+        g_string_free(req->body, TRUE);
+        req->body = g_string_sized_new(1024);
+    }
+
+    req->callback = NULL;
+    req->user_data = NULL;
+
+    g_mutex_lock(&pool_lock);
+    g_queue_push_head(&request_pool, req);
+    g_mutex_unlock(&pool_lock);
+}
+
+/**
+ * Free a pooled request
+ */
+static void request_free(gpointer data)
+{
+    VapixRequest *req = data;
+
+    g_string_free(req->path, TRUE);
+    g_string_free(req->content_type, TRUE);
+    g_string_free(req->body, TRUE);
+    g_free(req);
+}
+
+/**
+ * Worker thread function, runs one queued request
+ */
+static void request_run(gpointer data, gpointer user_data)
+{
+    VapixRequest *req = data;
+    VapixQueue *queue = user_data;
+    int attempt;
+
+    g_atomic_int_inc(&queue->running);
+
+    if (req->want_response) {
+        req->response = buffer_get();
+    }
+
+    req->status = -1;
+
+    for (attempt = 0; attempt < VAPIX_ATTEMPTS; attempt++) {
+        gboolean open = breaker_is_open();
+        gboolean sent = FALSE;
+
+        if (g_atomic_int_get(&closing)) {
+            req->status = VAPIX_CANCELLED;
+            break;
+        }
+
+        if (open && !queue->critical) {
+            LOG("VAPIX server unhealthy, shedding %s request to %s",
+                queue->name, req->path->str);
+            g_atomic_int_inc(&queue->shed);
+            req->dropped = TRUE;
+            break;
+        }
+
+        if (attempt > 0) {
+            g_atomic_int_inc(&queue->retried);
+            backoff(attempt);
+        }
+
+        req->status = post_once(req->path->str, req->content_type->str,
+            req->body->str, req->body->len, req->response, &sent);
+
+        breaker_record(req->status > 0 && req->status < 500);
+
+        /* Only retry what the server did not act on, and do not add load
+         * while the breaker is open
+         */
+        if ((req->status > 0 && !status_is_busy(req->status)) ||
+            (req->status < 0 && sent) || breaker_is_open()) {
+            break;
+        }
+    }
+
+    g_atomic_int_add(&queue->running, -1);
+
+    request_finish(req);
+}
+
+/**
+ * Hand a finished request to the main loop, from any thread
+ */
+static void request_finish(VapixRequest *req)
+{
+    g_mutex_lock(&finished_lock);
+
+    g_queue_push_tail(&finished, req);
+
+    /* Kept here rather than in the main context so cleanup can reach it */
+    if (!finished_source) {
+        finished_source = g_idle_add_full(G_PRIORITY_DEFAULT, requests_done,
+            NULL, NULL);
+    }
+
+    g_mutex_unlock(&finished_lock);
+}
+
+/**
+ * Idle callback calling the user callbacks of finished requests
+ */
+static gboolean requests_done(gpointer user_data)
+{
+    GQueue done;
+    VapixRequest *req;
+
+    (void) user_data;
+
+    g_mutex_lock(&finished_lock);
+    done = finished;
+    g_queue_init(&finished);
+    finished_source = 0;
+    g_mutex_unlock(&finished_lock);
+
+    while ((req = g_queue_pop_head(&done))) {
+        /* Shed and rejected requests have their own counters */
+        if (!req->dropped) {
+            req->queue->completed++;
+        }
+
+        if (req->callback) {
+            req->callback(req->status,
+                req->status > 0 && req->response ? req->response->str : NULL,
+                req->user_data);
+        }
+
+        request_put(req);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Initialize the VAPIX client with credentials for the local web server
+ */
+void vapix_init(const char *user, const char *pass)
+{
+    g_mutex_lock(&auth_lock);
+
+    g_free(username);
+    g_free(password);
+
+    username = g_strdup(user);
+    password = g_strdup(pass);
+
+    /* HA1 was computed from the old credentials */
+    auth_clear();
+
+    g_mutex_unlock(&auth_lock);
+
+    g_atomic_int_set(&closing, FALSE);
+
+    queues_init();
+}
+
+/**
+ * Close the persistent connections and free client resources
+ */
+void vapix_cleanup()
+{
+    GQueue done;
+    VapixRequest *req;
+    int i;
+
+    /* Queued requests are cancelled unsent, running ones end after their
+     * current attempt
+     */
+    g_atomic_int_set(&closing, TRUE);
+
+    for (i = 0; i < VAPIX_CLASSES; i++) {
+        if (queues[i].pool) {
+            g_thread_pool_free(queues[i].pool, FALSE, TRUE);
+            queues[i].pool = NULL;
+        }
+    }
+
+    /* The main loop is no longer running to call back */
+    g_mutex_lock(&finished_lock);
+
+    if (finished_source) {
+        g_source_remove(finished_source);
+        finished_source = 0;
+    }
+
+    done = finished;
+    g_queue_init(&finished);
+    g_mutex_unlock(&finished_lock);
+
+    while ((req = g_queue_pop_head(&done))) {
+        if (req->callback) {
+            req->callback(VAPIX_CANCELLED, NULL, req->user_data);
+        }
+
+        request_put(req);
+    }
+
+    while (!g_queue_is_empty(&idle_connections)) {
+        conn_free(g_queue_pop_head(&idle_connections));
+    }
+
+    while (!g_queue_is_empty(&buffer_pool)) {
+        g_string_free(g_queue_pop_head(&buffer_pool), TRUE);
+    }
+
+    while (!g_queue_is_empty(&request_pool)) {
+        request_free(g_queue_pop_head(&request_pool));
+    }
+
+    auth_clear();
+
+    g_free(username);
+    g_free(password);
+
+    username = password = NULL;
+}
+
+/**
+ * POST a request to a VAPIX CGI on 127.0.0.1 over a keep-alive connection.
+ */
+int vapix_post(const char *path, const char *content_type,
+    const char *body, gsize length, GString *response)
+{
+    return post_once(path, content_type, body, length, response, NULL);
+}
+
+/**
+ * Queue a POST request for the VAPIX worker and return immediately.
+ */
+void vapix_post_async(VapixClass cls, const char *path,
+    const char *content_type, const char *body, gsize length,
+    gboolean want_response, VapixCallback callback, gpointer user_data)
+{
+    VapixQueue *queue = &queues[cls];
+    VapixRequest *req = request_get();
+    guint depth;
+
+    req->queue = queue;
+    g_string_assign(req->path, path);
+    g_string_assign(req->content_type, content_type);
+    g_string_truncate(req->body, 0);
+    g_string_append_len(req->body, body, length);
+    req->want_response = want_response;
+    req->dropped = FALSE;
+    req->callback = callback;
+    req->user_data = user_data;
+
+    queues_init();
+
+    if (!queue->critical && breaker_is_open()) {
+        LOG("VAPIX server unhealthy, shedding %s request to %s",
+            queue->name, path);
+
+        g_atomic_int_inc(&queue->shed);
+        req->status = -1;
+        req->dropped = TRUE;
+        request_finish(req);
+        return;
+    }
+
+    if (g_thread_pool_unprocessed(queue->pool) >= queue->max_queued) {
+        ERR("VAPIX %s queue full, dropping request to %s", queue->name,
+            path);
+
+        /* Completes from an idle callback like a failed request would */
+        queue->rejected++;
+        req->status = -1;
+        req->dropped = TRUE;
+        request_finish(req);
+        return;
+    }
+
+    g_thread_pool_push(queue->pool, req, NULL);
+
+    depth = g_thread_pool_unprocessed(queue->pool) +
+        g_atomic_int_get(&queue->running);
+    queue->peak = MAX(queue->peak, depth);
+}
+
+/**
+ * Write queue depth and counters of each request class as XML elements
+ */
+void vapix_report(GString *xml)
+{
+    int i;
+
+    g_mutex_lock(&breaker_lock);
+    g_string_append_printf(xml, "<breaker open='%d' failures='%u' "
+        "trips='%u'/>", breaker_until > g_get_monotonic_time(),
+        breaker_failures, breaker_trips);
+    g_mutex_unlock(&breaker_lock);
+
+    for (i = 0; i < VAPIX_CLASSES; i++) {
+        VapixQueue *queue = &queues[i];
+
+        g_string_append_printf(xml, "<queue name='%s' queued='%u' "
+            "running='%d' peak='%u' limit='%d' size='%u' completed='%u' "
+            "rejected='%u' retried='%d' shed='%d'/>", queue->name,
+            queue->pool ? g_thread_pool_unprocessed(queue->pool) : 0,
+            g_atomic_int_get(&queue->running), queue->peak,
+            queue->max_running, queue->max_queued, queue->completed,
+            queue->rejected, g_atomic_int_get(&queue->retried),
+            g_atomic_int_get(&queue->shed));
+    }
+}
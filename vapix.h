@@ -0,0 +1,73 @@
+#ifndef INCLUSION_GUARD_VAPIX_H
+#define INCLUSION_GUARD_VAPIX_H
+
+/**
+ * Status of requests that vapix_cleanup() ended before they completed
+ */
+#define VAPIX_CANCELLED     -2
+
+/**
+ * Completion callback for asynchronous requests, called from the main loop.
+ * status is the HTTP status code or -1 on transport failure, response is
+ * the body if it was asked for, otherwise NULL. The response buffer is
+ * recycled once the callback returns. With VAPIX_CANCELLED the callback
+ * is called from vapix_cleanup() and should only release user_data.
+ */
+typedef void (*VapixCallback)(int status, const char *response,
+    gpointer user_data);
+
+/**
+ * Request classes, each with its own workers and bounded queue so that
+ * independent operations can overlap
+ */
+typedef enum {
+    VAPIX_OVERLAY,
+    VAPIX_UPLOAD,
+    VAPIX_WIPER,
+    VAPIX_CLASSES
+} VapixClass;
+
+/**
+ * Initialize the VAPIX client with credentials for the local web server
+ */
+void vapix_init(const char *username, const char *password);
+
+/**
+ * Close the persistent connections and free client resources. Requests
+ * that have not completed are cancelled, their callbacks get
+ * VAPIX_CANCELLED.
+ */
+void vapix_cleanup();
+
+/**
+ * POST a request to a VAPIX CGI on 127.0.0.1 over a keep-alive connection.
+ *
+ * Returns the HTTP status code or -1 on transport failure. If response is
+ * non-NULL the body is read into it, replacing its contents, otherwise the
+ * body is discarded. Makes a single attempt and blocks the caller, use
+ * vapix_post_async() from the main loop.
+ */
+int vapix_post(const char *path, const char *content_type,
+    const char *body, gsize length, GString *response);
+
+/**
+ * Queue a POST request for the workers of a class and return immediately.
+ *
+ * Requests of a class limited to one worker are sent in the order they are
+ * queued. When done, callback (if non-NULL) is called from the main loop
+ * with the result. Requests the server did not act on are retried with
+ * jittered exponential backoff. If the queue is full, or the class is not
+ * critical and the server has been failing, the request is dropped and the
+ * callback gets status -1. The body is copied so the caller may free it
+ * right away.
+ */
+void vapix_post_async(VapixClass cls, const char *path,
+    const char *content_type, const char *body, gsize length,
+    gboolean want_response, VapixCallback callback, gpointer user_data);
+
+/**
+ * Write queue depth and counters of each request class as XML elements
+ */
+void vapix_report(GString *xml);
+
+#endif // INCLUSION_GUARD_VAPIX_H
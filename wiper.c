@@ -0,0 +1,175 @@
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <syslog.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "overlays.h"
+#include "overlay_commands.h"
+#include "wiper.h"
+
+/******************** MACRO DEFINITION SECTION ********************************/
+
+/**
+ * Log message macro
+ */
+#define LOG(fmt, args...)   { syslog(LOG_INFO, fmt, ## args); \
+    g_message(fmt, ## args); }
+
+/******************** LOCAL VARIABLE DECLARATION SECTION **********************/
+
+/**
+ * Timer for the running cycle, 0 when the wiper is idle
+ */
+static guint cycle_source = 0;
+
+/**
+ * TRUE while the start request is in flight
+ */
+static gboolean starting = FALSE;
+
+/**
+ * Monotonic time in microseconds the last cycle ended
+ */
+static gint64 cycle_end = 0;
+
+/**
+ * Cooldown in seconds after a cycle
+ */
+static guint cooldown = 0;
+
+/**
+ * Number of requests received
+ */
+static guint requested = 0;
+
+/**
+ * Number of requests dropped because a cycle ran or was cooling down
+ */
+static guint suppressed = 0;
+
+/**
+ * Number of cycles the camera started
+ */
+static guint started = 0;
+
+/**
+ * Number of start requests that failed or were dropped
+ */
+static guint failed = 0;
+
+/******************** LOCAL FUNCTION DECLARATION SECTION **********************/
+
+/**
+ * Timer callback marking the end of a cycle
+ */
+static gboolean cycle_done(gpointer user_data);
+
+/**
+ * Completion of the start request, the cycle runs from here on success
+ */
+static void cycle_started(int status, const char *response,
+    gpointer user_data);
+
+/******************** LOCAL FUNCTION DEFINTION SECTION ************************/
+
+/**
+ * Timer callback marking the end of a cycle
+ */
+static gboolean cycle_done(gpointer user_data)
+{
+    (void) user_data;
+
+    cycle_source = 0;
+    cycle_end = g_get_monotonic_time();
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Completion of the start request, the cycle runs from here on success
+ */
+static void cycle_started(int status, const char *response,
+    gpointer user_data)
+{
+    (void) response;
+    (void) user_data;
+
+    starting = FALSE;
+
+    if (status == VAPIX_CANCELLED) {
+        return;
+    }
+
+    /* Shed, rejected or refused, a later request may try again at once */
+    if (status < 200 || status >= 300) {
+        failed++;
+        LOG("Wiper did not start, status %d, %u failed starts", status,
+            failed);
+        return;
+    }
+
+    started++;
+    cycle_source = g_timeout_add_seconds(WIPER_DURATION, cycle_done, NULL);
+}
+
+/******************** GLOBAL FUNCTION DEFINTION SECTION ***********************/
+
+/**
+ * Ask for a wiper cycle.
+ */
+gboolean wiper_request()
+{
+    requested++;
+
+    if (starting || cycle_source) {
+        suppressed++;
+        LOG("Wiper already running, %u requests suppressed", suppressed);
+        return FALSE;
+    }
+
+    if (cycle_end && g_get_monotonic_time() - cycle_end <
+        (gint64) cooldown * G_USEC_PER_SEC) {
+        suppressed++;
+        LOG("Wiper cooling down, %u requests suppressed", suppressed);
+        return FALSE;
+    }
+
+    LOG("RUNNING WIPER");
+
+    starting = TRUE;
+    run_wiper(cycle_started, NULL);
+
+    return TRUE;
+}
+
+/**
+ * Set the time in seconds after a finished cycle before a new one may start
+ */
+void wiper_set_cooldown(guint seconds)
+{
+    cooldown = seconds;
+}
+
+/**
+ * Write wiper scheduler counters as an XML element
+ */
+void wiper_report(GString *xml)
+{
+    g_string_append_printf(xml, "<wiper running='%d' requested='%u' "
+        "suppressed='%u' started='%u' failed='%u' cooldown='%u'/>",
+        cycle_source != 0, requested, suppressed, started, failed, cooldown);
+}
+
+/**
+ * Cancel the cycle timer
+ */
+void wiper_cleanup()
+{
+    if (cycle_source) {
+        g_source_remove(cycle_source);
+        cycle_source = 0;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef INCLUSION_GUARD_WIPER_H
+#define INCLUSION_GUARD_WIPER_H
+
+/**
+ * Ask for a wiper cycle. Dropped while a cycle is starting or running or
+ * within the cooldown after it, returns TRUE if a start was requested. The
+ * cycle only counts as running once the camera accepted the start.
+ */
+gboolean wiper_request();
+
+/**
+ * Set the time in seconds after a finished cycle before a new one may start
+ */
+void wiper_set_cooldown(guint seconds);
+
+/**
+ * Write wiper scheduler counters as an XML element
+ */
+void wiper_report(GString *xml);
+
+/**
+ * Cancel the cycle timer
+ */
+void wiper_cleanup();
+
+#endif // INCLUSION_GUARD_WIPER_H